@@ -0,0 +1,14 @@
+/*
+ * assemble.h
+ */
+
+#ifndef _ASSEMBLE_H_
+#define _ASSEMBLE_H_
+
+#include <stddef.h>
+#include <stdio.h>
+
+extern void assembleFile(char *name, FILE *fp);
+extern void assembleBuffer(char *data, size_t size, FILE *fp);
+
+#endif
@@ -44,6 +44,9 @@ const static struct convert_table tbl_comp[] = {
     {"A-D", 0b1110000111000000},
     {"D&A", 0b1110000000000000},
     {"D|A", 0b1110010101000000},
+    {"A+D", 0b1110000010000000},    // the same, operands swapped
+    {"A&D", 0b1110000000000000},
+    {"A|D", 0b1110010101000000},
     {"M",   0b1111110000000000},
     {"!M",  0b1111110001000000},
     {"-M",  0b1111110011000000},
@@ -54,6 +57,9 @@ const static struct convert_table tbl_comp[] = {
     {"M-D", 0b1111000111000000},
     {"D&M", 0b1111000000000000},
     {"D|M", 0b1111010101000000},
+    {"M+D", 0b1111000010000000},
+    {"M&D", 0b1111000000000000},
+    {"M|D", 0b1111010101000000},
 };
 
 const static struct convert_table tbl_jump[] = {
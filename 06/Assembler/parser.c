@@ -13,16 +13,11 @@
 #define LINE_BLOCK_SIZE 1024
 
 
-void _parser_init(Parser *pThis, char *name)
+static void readLines(Parser *pThis, FILE *fp);
+
+void _asm_parser_init(Parser *pThis, char *name)
 {
     FILE *fp;
-    char *buff;
-    int ch;
-    int indx = 0;
-    int line_num = 0;
-    int slash_cnt = 0;
-    int buff_block_num = 1;
-    int line_block_num = 1;
 
     fp = fopen(name, "r");
 
@@ -31,6 +26,37 @@ void _parser_init(Parser *pThis, char *name)
         exit errno;
     }
 
+    readLines(pThis, fp);
+    fclose(fp);
+}
+
+// assembly that is already in memory, read as if it were a file
+void _asm_parser_initBuffer(Parser *pThis, char *data, size_t size)
+{
+    FILE *fp;
+
+    fp = fmemopen(data, size, "r");
+
+    if (fp == NULL) {
+        fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
+        exit errno;
+    }
+
+    readLines(pThis, fp);
+    fclose(fp);
+}
+
+// every line that is not blank once spaces and comments are dropped
+static void readLines(Parser *pThis, FILE *fp)
+{
+    char *buff;
+    int ch;
+    int indx = 0;
+    int line_num = 0;
+    int slash_cnt = 0;
+    int buff_block_num = 1;
+    int line_block_num = 1;
+
     buff = (char *)malloc(sizeof(unsigned char) * BUFF_BLOCK_SIZE * buff_block_num);
     pThis->lines = (char **)malloc(sizeof(char *)
                                     * LINE_BLOCK_SIZE * line_block_num);
@@ -81,25 +107,24 @@ void _parser_init(Parser *pThis, char *name)
     pThis->max_line = LINE_BLOCK_SIZE * line_block_num;
 
     free(buff);
-    fclose(fp);
 }
 
-bool _parser_hasMoreCommands(Parser *pThis)
+bool _asm_parser_hasMoreCommands(Parser *pThis)
 {
     return pThis->lines[pThis->current_line + 1] == NULL ? false : true;
 }
 
-void _parser_advance(Parser *pThis)
+void _asm_parser_advance(Parser *pThis)
 {
     pThis->current_line++;
 }
 
-void _parser_reset(Parser *pThis)
+void _asm_parser_reset(Parser *pThis)
 {
     pThis->current_line = -1;
 }
 
-int _parser_commandType(Parser *pThis)
+int _asm_parser_commandType(Parser *pThis)
 {
     char *current_command = pThis->lines[pThis->current_line];
 
@@ -111,7 +136,7 @@ int _parser_commandType(Parser *pThis)
         return C_COMMAND;
 }
 
-char *_parser_symbol(Parser *pThis)
+char *_asm_parser_symbol(Parser *pThis)
 {
     char *current_command = pThis->lines[pThis->current_line];
     size_t len = strlen(current_command);
@@ -142,14 +167,14 @@ char *_parser_symbol(Parser *pThis)
     }
 }
 
-char *_parser_dest(Parser *pThis)
+char *_asm_parser_dest(Parser *pThis)
 {
     char *current_command;
     size_t len = strlen(pThis->lines[pThis->current_line]);
     char *dest;
 
     free(pThis->current_dest);
-    pThis->current_dest = (char *)malloc(sizeof(unsigned char) * len + 1);
+    pThis->current_dest = (char *)malloc(sizeof(unsigned char) * len + sizeof("null"));
 
     //For using strtok
     current_command = (char *)malloc(len + 1);
@@ -171,7 +196,7 @@ char *_parser_dest(Parser *pThis)
 }
 
 
-char *_parser_comp(Parser *pThis)
+char *_asm_parser_comp(Parser *pThis)
 {
     char *current_command = pThis->lines[pThis->current_line];
     size_t len = strlen(current_command);
@@ -205,7 +230,7 @@ char *_parser_comp(Parser *pThis)
     return pThis->current_comp;
 }
 
-char *_parser_jump(Parser *pThis)
+char *_asm_parser_jump(Parser *pThis)
 {
     char *current_command = pThis->lines[pThis->current_line];
     size_t len = strlen(current_command);
@@ -213,7 +238,7 @@ char *_parser_jump(Parser *pThis)
     char *jump = NULL;
 
     free(pThis->current_jump);
-    pThis->current_jump = (char *)malloc(sizeof(unsigned char) * len + 1);
+    pThis->current_jump = (char *)malloc(sizeof(unsigned char) * len + sizeof("null"));
 
     //For using strtok
     current_command = (char *)malloc(len + 1);
@@ -233,7 +258,7 @@ char *_parser_jump(Parser *pThis)
     return pThis->current_jump;
 }
 
-void _parser_delete(Parser *pThis)
+void _asm_parser_delete(Parser *pThis)
 {
     int i;
 
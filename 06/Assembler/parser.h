@@ -6,6 +6,7 @@
 #define _PARSER_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 
 enum commandType {
     A_COMMAND,
@@ -23,6 +24,7 @@ typedef struct parser {
     char *current_jump;
 
     void (*init)(struct parser *, char *);
+    void (*initBuffer)(struct parser *, char *, size_t);
     bool (*hasMoreCommands)(struct parser *);
     void (*advance)(struct parser *);
     void (*reset)(struct parser *);
@@ -34,34 +36,36 @@ typedef struct parser {
     void (*del)(struct parser *);
 } Parser;
 
-extern void _parser_init(Parser *pThis, char *name);
-extern bool _parser_hasMoreCommands(Parser *pThis);
-extern void _parser_advance(Parser *pThis);
-extern void _parser_reset(Parser *pThis);
-extern int  _parser_commandType(Parser *pThis);
-extern char *_parser_symbol(Parser *pThis);
-extern char *_parser_dest(Parser *pThis);
-extern char *_parser_comp(Parser *pThis);
-extern char *_parser_jump(Parser *pThis);
-extern void _parser_delete(Parser *pThis);
+extern void _asm_parser_init(Parser *pThis, char *name);
+extern void _asm_parser_initBuffer(Parser *pThis, char *data, size_t size);
+extern bool _asm_parser_hasMoreCommands(Parser *pThis);
+extern void _asm_parser_advance(Parser *pThis);
+extern void _asm_parser_reset(Parser *pThis);
+extern int  _asm_parser_commandType(Parser *pThis);
+extern char *_asm_parser_symbol(Parser *pThis);
+extern char *_asm_parser_dest(Parser *pThis);
+extern char *_asm_parser_comp(Parser *pThis);
+extern char *_asm_parser_jump(Parser *pThis);
+extern void _asm_parser_delete(Parser *pThis);
 
-#define newParser() {       \
-    .lines = NULL,          \
-    .current_line = -1,     \
-    .current_symbol = NULL, \
-    .current_dest = NULL,   \
-    .current_comp = NULL,   \
-    .current_jump = NULL,   \
-    .init = _parser_init,           \
-    .hasMoreCommands = _parser_hasMoreCommands, \
-    .advance = _parser_advance,                 \
-    .reset = _parser_reset,                     \
-    .commandType = _parser_commandType,         \
-    .symbol = _parser_symbol,                   \
-    .dest = _parser_dest,                       \
-    .comp = _parser_comp,                       \
-    .jump = _parser_jump,                       \
-    .del = _parser_delete,                      \
+#define newParser() {                               \
+    .lines = NULL,                                  \
+    .current_line = -1,                             \
+    .current_symbol = NULL,                         \
+    .current_dest = NULL,                           \
+    .current_comp = NULL,                           \
+    .current_jump = NULL,                           \
+    .init = _asm_parser_init,                       \
+    .initBuffer = _asm_parser_initBuffer,           \
+    .hasMoreCommands = _asm_parser_hasMoreCommands, \
+    .advance = _asm_parser_advance,                 \
+    .reset = _asm_parser_reset,                     \
+    .commandType = _asm_parser_commandType,         \
+    .symbol = _asm_parser_symbol,                   \
+    .dest = _asm_parser_dest,                       \
+    .comp = _asm_parser_comp,                       \
+    .jump = _asm_parser_jump,                       \
+    .del = _asm_parser_delete,                      \
 }
 
 #endif
@@ -0,0 +1,156 @@
+/*
+ * call_graph.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "call_graph.h"
+
+#define NODE_BLOCK_SIZE   256
+#define CALLEE_BLOCK_SIZE 16
+
+static struct call_graph_node *search_node(CallGraph *pThis, char *name);
+
+void _call_graph_init(CallGraph *pThis)
+{
+    pThis->nodes = (struct call_graph_node *)malloc(sizeof(struct call_graph_node) * NODE_BLOCK_SIZE);
+    pThis->num_nodes = 0;
+
+    return;
+}
+
+void _call_graph_addFunction(CallGraph *pThis, char *name)
+{
+    struct call_graph_node *node;
+
+    if (search_node(pThis, name) != NULL) return;
+
+    if (pThis->num_nodes != 0 && pThis->num_nodes % NODE_BLOCK_SIZE == 0) {
+        pThis->nodes = (struct call_graph_node *)realloc(pThis->nodes,
+                            sizeof(struct call_graph_node) * (pThis->num_nodes + NODE_BLOCK_SIZE));
+    }
+
+    node = &pThis->nodes[pThis->num_nodes];
+    node->name = (char *)malloc(sizeof(char) * strlen(name) + 1);
+    strcpy(node->name, name);
+    node->callees     = NULL;
+    node->num_callees = 0;
+    node->reachable   = false;
+    node->inlined     = false;
+
+    pThis->num_nodes++;
+
+    return;
+}
+
+void _call_graph_addCall(CallGraph *pThis, char *caller, char *callee)
+{
+    struct call_graph_node *node;
+    int i;
+
+    if ((node = search_node(pThis, caller)) == NULL) return;
+
+    for (i = 0; i < node->num_callees; i++)
+        if (!strcmp(node->callees[i], callee)) return;
+
+    if (node->num_callees % CALLEE_BLOCK_SIZE == 0) {
+        node->callees = (char **)realloc(node->callees,
+                            sizeof(char *) * (node->num_callees + CALLEE_BLOCK_SIZE));
+    }
+
+    node->callees[node->num_callees] = (char *)malloc(sizeof(char) * strlen(callee) + 1);
+    strcpy(node->callees[node->num_callees], callee);
+    node->num_callees++;
+
+    return;
+}
+
+bool _call_graph_contains(CallGraph *pThis, char *name)
+{
+    return search_node(pThis, name) == NULL ? false : true;
+}
+
+void _call_graph_markInlined(CallGraph *pThis, char *name)
+{
+    struct call_graph_node *node;
+
+    if ((node = search_node(pThis, name)) == NULL) return;
+
+    node->inlined = true;
+
+    return;
+}
+
+void _call_graph_markReachable(CallGraph *pThis, char *root)
+{
+    struct call_graph_node **stack, *node, *callee;
+    int sp = 0;
+    int i;
+
+    if ((node = search_node(pThis, root)) == NULL) return;
+
+    // every node is pushed at most once, so num_nodes slots are enough
+    stack = (struct call_graph_node **)malloc(sizeof(struct call_graph_node *) * pThis->num_nodes);
+
+    node->reachable = true;
+    stack[sp++] = node;
+
+    while (sp > 0) {
+        node = stack[--sp];
+
+        for (i = 0; i < node->num_callees; i++) {
+            callee = search_node(pThis, node->callees[i]);
+            if (callee == NULL || callee->reachable) continue;
+
+            // every call to an inlined function is replaced by its body
+            if (callee->inlined) continue;
+
+            callee->reachable = true;
+            stack[sp++] = callee;
+        }
+    }
+
+    free(stack);
+
+    return;
+}
+
+bool _call_graph_isReachable(CallGraph *pThis, char *name)
+{
+    struct call_graph_node *node;
+
+    node = search_node(pThis, name);
+
+    return node == NULL ? false : node->reachable;
+}
+
+void _call_graph_del(CallGraph *pThis)
+{
+    int i, j;
+
+    for (i = 0; i < pThis->num_nodes; i++) {
+        for (j = 0; j < pThis->nodes[i].num_callees; j++)
+            free(pThis->nodes[i].callees[j]);
+        free(pThis->nodes[i].callees);
+        free(pThis->nodes[i].name);
+    }
+
+    free(pThis->nodes);
+    pThis->nodes = NULL;
+    pThis->num_nodes = 0;
+
+    return;
+}
+
+static struct call_graph_node *search_node(CallGraph *pThis, char *name)
+{
+    int i;
+
+    for (i = 0; i < pThis->num_nodes; i++)
+        if (!strcmp(pThis->nodes[i].name, name))
+            return &pThis->nodes[i];
+
+    return NULL;
+}
@@ -0,0 +1,54 @@
+/*
+ * call_graph.h
+ */
+
+#ifndef _CALL_GRAPH_H_
+#define _CALL_GRAPH_H_
+
+#include <stdbool.h>
+
+struct call_graph_node {
+    char *name;
+    char **callees;
+    int  num_callees;
+    bool reachable;
+    bool inlined;
+};
+
+typedef struct call_graph {
+    struct call_graph_node *nodes;
+    int num_nodes;
+
+    void (*init)(struct call_graph *);
+    void (*addFunction)(struct call_graph *, char *);
+    void (*addCall)(struct call_graph *, char *, char *);
+    bool (*contains)(struct call_graph *, char *);
+    void (*markInlined)(struct call_graph *, char *);
+    void (*markReachable)(struct call_graph *, char *);
+    bool (*isReachable)(struct call_graph *, char *);
+    void (*del)(struct call_graph *);
+} CallGraph;
+
+extern void _call_graph_init(CallGraph *pThis);
+extern void _call_graph_addFunction(CallGraph *pThis, char *name);
+extern void _call_graph_addCall(CallGraph *pThis, char *caller, char *callee);
+extern bool _call_graph_contains(CallGraph *pThis, char *name);
+extern void _call_graph_markInlined(CallGraph *pThis, char *name);
+extern void _call_graph_markReachable(CallGraph *pThis, char *root);
+extern bool _call_graph_isReachable(CallGraph *pThis, char *name);
+extern void _call_graph_del(CallGraph *pThis);
+
+#define newCallGraph() {                            \
+    .nodes         = NULL,                          \
+    .num_nodes     = 0,                             \
+    .init          = _call_graph_init,              \
+    .addFunction   = _call_graph_addFunction,       \
+    .addCall       = _call_graph_addCall,           \
+    .contains      = _call_graph_contains,          \
+    .markInlined   = _call_graph_markInlined,       \
+    .markReachable = _call_graph_markReachable,     \
+    .isReachable   = _call_graph_isReachable,       \
+    .del           = _call_graph_del,               \
+}
+
+#endif
@@ -6,9 +6,22 @@
 #include "code_writer.h"
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #define SIZE_OF_ARRAY(a) ((sizeof(a)) / (sizeof(a[0])))
 
+// assembly is collected here and written out one megabyte at a time;
+// a writer without a file keeps growing its buffer instead
+#define OUTPUT_BUFFER_SIZE (1024 * 1024)
+
+#define OUT_LITERAL(pThis, s) out_bytes((pThis), (s), sizeof(s) - 1)
+
+// fused stores to a base register segment walk A up to the slot when it is
+// close, otherwise the address is computed into R13 before D is loaded
+#define STORE_WALK_MAX 2
+
 struct assemble_conv_list {
     char *command;
     char *assemble;
@@ -16,29 +29,127 @@ struct assemble_conv_list {
 };
 
 struct push_pop_conv_list {
-    char *segment;
+    enum segmentType segment;
     char *label;
     void (*write_code_template)(CodeWriter *, const char *, int);
 };
 
+// indexes into arithmetic_list
+enum arithmeticOperator {
+    AR_ADD, AR_SUB, AR_NEG, AR_EQ, AR_GT, AR_LT, AR_AND, AR_OR, AR_NOT,
+};
+
+// what a pending sequence can still become
+enum fuseMatch {
+    FUSE_NONE,
+    FUSE_PREFIX,
+    FUSE_MOVE,              // push S i; pop T j
+    FUSE_PUSH_BINARY,       // push S i; add|sub|and|or
+    FUSE_PUSH_ADD_CONSTANT, // push S i; push constant k; add|sub
+    FUSE_PUSH_NEG_CONSTANT, // push constant k; neg
+    FUSE_BINARY_POP,        // add|sub|and|or; pop T j
+};
+
 static void write_unary_function_code(CodeWriter *pThis, const char *assemble);
 static void write_binary_function_code(CodeWriter *pThis, const char *assemble);
 static void write_compare_function_code(CodeWriter *pThis, const char *assemble);
 
-static void write_push_code(CodeWriter *pThis, const char *segment, int index);
+static const struct assemble_conv_list arithmetic_list[] = {
+    {"add", "M=M+D", write_binary_function_code},
+    {"sub", "M=M-D", write_binary_function_code},
+    {"neg", "M=-M",  write_unary_function_code},
+    {"eq",  "JEQ",   write_compare_function_code},
+    {"gt",  "JGT",   write_compare_function_code},
+    {"lt",  "JLT",   write_compare_function_code},
+    {"and", "M=M&D", write_binary_function_code},
+    {"or",  "M=M|D", write_binary_function_code},
+    {"not", "M=!M" , write_unary_function_code},
+    {NULL,  NULL,      NULL},
+};
+
+static const char *base_regs[] = {
+    [S_LOCAL] = "LCL", [S_ARGUMENT] = "ARG", [S_THIS] = "THIS", [S_THAT] = "THAT",
+};
+
+static void out_write(CodeWriter *pThis, const char *bytes, size_t len);
+static void out_flush(CodeWriter *pThis);
+static void out_bytes(CodeWriter *pThis, const char *bytes, size_t len);
+static void out_char(CodeWriter *pThis, char ch);
+static void out_str(CodeWriter *pThis, const char *str);
+static void out_int(CodeWriter *pThis, long num);
+static void out_at_str(CodeWriter *pThis, const char *str);
+static void out_at_int(CodeWriter *pThis, long num);
+static void out_label(CodeWriter *pThis, const char *str);
+static const char *label_scope(CodeWriter *pThis);
+static void out_scope(CodeWriter *pThis);
+static void out_jump_label(CodeWriter *pThis, const char *label);
+
+static void write_arithmetic_code(CodeWriter *pThis, int op);
+static void write_push_pop_code(CodeWriter *pThis, enum commandType command, enum segmentType segment, int index);
+
+static void write_push_code(CodeWriter *pThis, enum segmentType segment, int index);
 static void write_push_constant(CodeWriter *pThis, const char *regs, int index);
 static void write_push_with_base_regs(CodeWriter *pThis, const char *regs, int index);
 static void write_push_with_base_addr(CodeWriter *pThis, const char *addr, int index);
 static void write_push_static(CodeWriter *pThis, const char *regs, int index);
 
-static void write_pop_code(CodeWriter *pThis, const char *segment, int index);
+static void write_pop_code(CodeWriter *pThis, enum segmentType segment, int index);
 static void write_pop_with_base_regs(CodeWriter *pThis, const char *regs, int index);
 static void write_pop_with_base_addr(CodeWriter *pThis, const char *addr, int index);
 static void write_pop_static(CodeWriter *pThis, const char *addr, int index);
 
+static void write_push_inline(CodeWriter *pThis, int offset);
+static void write_pop_inline(CodeWriter *pThis, int offset);
+static void write_inline_return(CodeWriter *pThis);
+static void flush_inline_jump(CodeWriter *pThis);
+
+static bool fusing(CodeWriter *pThis);
+static bool holding(CodeWriter *pThis);
+static void queue_command(CodeWriter *pThis, enum commandType type, enum segmentType segment, int index);
+static void flush_pending(CodeWriter *pThis);
+static void emit_pending(CodeWriter *pThis, int num);
+static bool is_push(struct fuse_command *c);
+static bool is_push_constant(struct fuse_command *c);
+static bool is_pop(struct fuse_command *c);
+static bool is_operator(struct fuse_command *c, int op);
+static bool is_binary(struct fuse_command *c);
+static bool is_compare(struct fuse_command *c);
+static enum fuseMatch match_pending(CodeWriter *pThis);
+static void write_fused_code(CodeWriter *pThis, enum fuseMatch match);
+static bool write_fused_if(CodeWriter *pThis, char *label);
+static void write_load_d(CodeWriter *pThis, enum segmentType segment, int index);
+static void write_store_d_begin(CodeWriter *pThis, enum segmentType segment, int index);
+static void write_store_d_end(CodeWriter *pThis, enum segmentType segment, int index);
+static void write_push_d(CodeWriter *pThis);
+
+static bool write_lowered_math(CodeWriter *pThis, char *functionName, int numArgs);
+static void write_multiply_constant(CodeWriter *pThis, int constant);
+static void write_divide_power(CodeWriter *pThis, int shift);
+static void out_at_local(CodeWriter *pThis, const char *name, int num);
+static void out_local_label(CodeWriter *pThis, const char *name, int num);
+
+static void set_emit_kind(CodeWriter *pThis, enum emitKind kind);
+static void count_output(CodeWriter *pThis);
+
 void _code_writer_init(CodeWriter *pThis, char *filename)
 {
-    pThis->fp = fopen(filename, "w");
+    pThis->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (pThis->fd == -1) {
+        fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
+        exit errno;
+    }
+
+    pThis->out = (char *)malloc(sizeof(char) * OUTPUT_BUFFER_SIZE);
+    pThis->out_len = 0;
+    pThis->out_size = OUTPUT_BUFFER_SIZE;
+}
+
+void _code_writer_initBuffer(CodeWriter *pThis)
+{
+    pThis->fd = -1;
+    pThis->out = (char *)malloc(sizeof(char) * OUTPUT_BUFFER_SIZE);
+    pThis->out_len = 0;
+    pThis->out_size = OUTPUT_BUFFER_SIZE;
 }
 
 void _code_writer_setFileName(CodeWriter *pThis, char *filename)
@@ -51,33 +162,88 @@ void _code_writer_setFileName(CodeWriter *pThis, char *filename)
     return;
 }
 
-void _code_writer_writeArithmetric(CodeWriter *pThis, char *command)
+void _code_writer_setFusion(CodeWriter *pThis, bool fuse)
 {
-    static const struct assemble_conv_list conv_list[]= {
-        {"add", "M=M+D", write_binary_function_code},
-        {"sub", "M=M-D", write_binary_function_code},
-        {"neg", "M=-M",  write_unary_function_code},
-        {"eq",  "JEQ",   write_compare_function_code},
-        {"gt",  "JGT",   write_compare_function_code},
-        {"lt",  "JLT",   write_compare_function_code},
-        {"and", "M=M&D", write_binary_function_code},
-        {"or",  "M=M|D", write_binary_function_code},
-        {"not", "M=!M" , write_unary_function_code},
-        {NULL,  NULL,      NULL},
-    };
+    flush_pending(pThis);
+    pThis->fuse = fuse;
 
+    return;
+}
+
+void _code_writer_setMathLowering(CodeWriter *pThis, bool lower)
+{
+    flush_pending(pThis);
+    pThis->lower_math = lower;
+
+    return;
+}
+
+// stats == NULL stops counting; whatever was written so far is counted first
+void _code_writer_setStatistics(CodeWriter *pThis, struct emit_stats *stats)
+{
+    flush_pending(pThis);
+    count_output(pThis);
+    pThis->stats = stats;
+    pThis->stats_mark = pThis->out_len;
+
+    return;
+}
+
+void _code_writer_writeArithmetric(CodeWriter *pThis, char *command)
+{
     int i;
 
-    for (i = 0; conv_list[i].command != NULL; i++) {
-        if (!strcmp(command, conv_list[i].command)) {
-            conv_list[i].write_code_template(pThis, conv_list[i].assemble);
-        }
-    }
+    for (i = 0; arithmetic_list[i].command != NULL; i++)
+        if (!strcmp(command, arithmetic_list[i].command)) break;
+
+    if (arithmetic_list[i].command == NULL) return;
+
+    if (holding(pThis))
+        queue_command(pThis, C_ARITHMETRIC, S_OTHER, i);
+    else
+        write_arithmetic_code(pThis, i);
 }
 
-void _code_writer_writePushPop(CodeWriter *pThis, enum commandType command, char *segment, int index)
+void _code_writer_writePushPop(CodeWriter *pThis, enum commandType command, enum segmentType segment, int index)
 {
-    if (segment == NULL) return;
+    if (segment == S_OTHER) return;
+
+    if (holding(pThis))
+        queue_command(pThis, command, segment, index);
+    else
+        write_push_pop_code(pThis, command, segment, index);
+}
+
+static void write_arithmetic_code(CodeWriter *pThis, int op)
+{
+    set_emit_kind(pThis, EMIT_ARITHMETIC);
+    flush_inline_jump(pThis);
+
+    arithmetic_list[op].write_code_template(pThis, arithmetic_list[op].assemble);
+}
+
+static void write_push_pop_code(CodeWriter *pThis, enum commandType command, enum segmentType segment, int index)
+{
+    set_emit_kind(pThis, EMIT_PUSH_POP);
+    flush_inline_jump(pThis);
+
+    // argument and local live in the caller's stack while a body is inlined
+    if (pThis->inline_frame.active) {
+        int offset = -1;
+
+        if (segment == S_ARGUMENT)
+            offset = index;
+        else if (segment == S_LOCAL)
+            offset = pThis->inline_frame.num_args + index;
+
+        if (offset >= 0) {
+            if (command == C_PUSH)
+                write_push_inline(pThis, offset);
+            else if (command == C_POP)
+                write_pop_inline(pThis, offset);
+            return;
+        }
+    }
 
     switch (command) {
         case C_PUSH:
@@ -98,10 +264,15 @@ void _code_writer_writeLabel(CodeWriter *pThis, char *label)
 {
     char *func = "null";
 
+    // a label can be jumped to, so nothing is fused across it
+    flush_pending(pThis);
+    set_emit_kind(pThis, EMIT_BRANCH);
+    flush_inline_jump(pThis);
+
     if (pThis->funcname)
         func = pThis->funcname;
 
-    fprintf(pThis->fp, "(%s$%s)\n", func, label);
+    out_char(pThis, '('); out_str(pThis, func); out_char(pThis, '$'); out_str(pThis, label); OUT_LITERAL(pThis, ")\n");
 
     return;
 }
@@ -110,11 +281,15 @@ void _code_writer_writeGoto(CodeWriter *pThis, char *label)
 {
     char *func = "null";
 
+    flush_pending(pThis);
+    set_emit_kind(pThis, EMIT_BRANCH);
+    flush_inline_jump(pThis);
+
     if (pThis->funcname)
         func = pThis->funcname;
 
-    fprintf(pThis->fp, "@%s$%s\n", func, label);
-    fprintf(pThis->fp, "0;JMP\n");
+    out_char(pThis, '@'); out_str(pThis, func); out_char(pThis, '$'); out_str(pThis, label); out_char(pThis, '\n');
+    OUT_LITERAL(pThis, "0;JMP\n");
 
     return;
 }
@@ -123,69 +298,93 @@ void _code_writer_writeIf(CodeWriter *pThis, char *label)
 {
     char *func = "null";
 
+    if (fusing(pThis) && write_fused_if(pThis, label)) return;
+
+    flush_pending(pThis);
+    set_emit_kind(pThis, EMIT_BRANCH);
+    flush_inline_jump(pThis);
+
     if (pThis->funcname)
         func = pThis->funcname;
 
-    fprintf(pThis->fp, "@SP\n");
-    fprintf(pThis->fp, "AM=M-1\n");
-    fprintf(pThis->fp, "D=M\n");
-    fprintf(pThis->fp, "@%s$%s\n", func, label);
-    fprintf(pThis->fp, "D;JNE\n");
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "AM=M-1\n");
+    OUT_LITERAL(pThis, "D=M\n");
+    out_char(pThis, '@'); out_str(pThis, func); out_char(pThis, '$'); out_str(pThis, label); out_char(pThis, '\n');
+    OUT_LITERAL(pThis, "D;JNE\n");
 
     return;
 }
 
-void _code_writer_writeInit(CodeWriter *pThis)
+void _code_writer_writeInit(CodeWriter *pThis, enum bootstrapMode mode, char *entry)
 {
-    fprintf(pThis->fp, "@256\n");                   // SP = 256
-    fprintf(pThis->fp, "D=A\n");
-    fprintf(pThis->fp, "@SP\n");
-    fprintf(pThis->fp, "M=D\n");
+    if (mode == BOOTSTRAP_NONE) return;
+
+    set_emit_kind(pThis, EMIT_CALL_RETURN);
 
-    _code_writer_writeCall(pThis, "Sys.init", 0);   //call Sys.init
+    OUT_LITERAL(pThis, "@256\n");                   // SP = 256
+    OUT_LITERAL(pThis, "D=A\n");
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "M=D\n");
+
+    if (mode == BOOTSTRAP_CALL) {
+        _code_writer_writeCall(pThis, entry, 0);    // call entry
+        return;
+    }
+
+    OUT_LITERAL(pThis, "@LCL\n");                   // an empty frame at the bottom of the stack
+    OUT_LITERAL(pThis, "M=D\n");
+    OUT_LITERAL(pThis, "@ARG\n");
+    OUT_LITERAL(pThis, "M=D\n");
+    out_at_str(pThis, entry);                       // goto entry
+    OUT_LITERAL(pThis, "0;JMP\n");
 }
 
 void _code_writer_writeCall(CodeWriter *pThis, char *functionName, int numArgs)
 {
     char *push_list[] = {"return-address", "LCL", "ARG", "THIS", "THAT"};
-    static int ret_num = 0;
     int i;
 
+    if (write_lowered_math(pThis, functionName, numArgs)) return;
+
+    flush_pending(pThis);
+    set_emit_kind(pThis, EMIT_CALL_RETURN);
+
     for (i = 0; i < SIZE_OF_ARRAY(push_list); i++) {                // each label in push_list push to stack
         if (!strcmp(push_list[i], "return-address")) {
-            fprintf(pThis->fp, "@%s%d\n", push_list[i], ret_num);
-            fprintf(pThis->fp, "D=A\n");
+            out_char(pThis, '@'); out_scope(pThis); OUT_LITERAL(pThis, "ret."); out_int(pThis, pThis->ret_num); out_char(pThis, '\n');
+            OUT_LITERAL(pThis, "D=A\n");
         } else {
-            fprintf(pThis->fp, "@%s\n", push_list[i]);
-            fprintf(pThis->fp, "D=M\n");
+            out_at_str(pThis, push_list[i]);
+            OUT_LITERAL(pThis, "D=M\n");
         }
 
-        fprintf(pThis->fp, "@SP\n");
-        fprintf(pThis->fp, "A=M\n");
-        fprintf(pThis->fp, "M=D\n");
-        fprintf(pThis->fp, "@SP\n");
-        fprintf(pThis->fp, "M=M+1\n");
+        OUT_LITERAL(pThis, "@SP\n");
+        OUT_LITERAL(pThis, "A=M\n");
+        OUT_LITERAL(pThis, "M=D\n");
+        OUT_LITERAL(pThis, "@SP\n");
+        OUT_LITERAL(pThis, "M=M+1\n");
     }
 
-    fprintf(pThis->fp, "@SP\n");                                    // ARG = SP - n - 5
-    fprintf(pThis->fp, "D=M\n");
+    OUT_LITERAL(pThis, "@SP\n");                                    // ARG = SP - n - 5
+    OUT_LITERAL(pThis, "D=M\n");
     for (i = 0; i < numArgs + 5; i++) {
-        fprintf(pThis->fp, "D=D-1\n");
+        OUT_LITERAL(pThis, "D=D-1\n");
     }
-    fprintf(pThis->fp, "@ARG\n");
-    fprintf(pThis->fp, "M=D\n");
+    OUT_LITERAL(pThis, "@ARG\n");
+    OUT_LITERAL(pThis, "M=D\n");
 
-    fprintf(pThis->fp, "@SP\n");                                    // LCL = SP
-    fprintf(pThis->fp, "D=M\n");
-    fprintf(pThis->fp, "@LCL\n");
-    fprintf(pThis->fp, "M=D\n");
+    OUT_LITERAL(pThis, "@SP\n");                                    // LCL = SP
+    OUT_LITERAL(pThis, "D=M\n");
+    OUT_LITERAL(pThis, "@LCL\n");
+    OUT_LITERAL(pThis, "M=D\n");
 
-    fprintf(pThis->fp, "@%s\n", functionName);                      // goto f
-    fprintf(pThis->fp, "0;JMP\n");
+    out_at_str(pThis, functionName);                                // goto f
+    OUT_LITERAL(pThis, "0;JMP\n");
 
-    fprintf(pThis->fp, "(return-address%d)\n", ret_num);            // (return-addressXX)
+    out_char(pThis, '('); out_scope(pThis); OUT_LITERAL(pThis, "ret."); out_int(pThis, pThis->ret_num); OUT_LITERAL(pThis, ")\n");    // (f$$ret.XX)
 
-    ret_num++;
+    pThis->ret_num++;
 
     return;
 }
@@ -194,158 +393,430 @@ void _code_writer_writeReturn(CodeWriter *pThis)
 {
     int i;
 
+    flush_pending(pThis);
+    set_emit_kind(pThis, EMIT_CALL_RETURN);
+    flush_inline_jump(pThis);
+
+    if (pThis->inline_frame.active) {
+        write_inline_return(pThis);
+        return;
+    }
+
     // R13: FRAME
     // R14: RET
 
-    fprintf(pThis->fp, "@LCL\n");
-    fprintf(pThis->fp, "D=M\n");
-    fprintf(pThis->fp, "@R13\n");
-    fprintf(pThis->fp, "M=D\n");        // FRAME = LCL
+    OUT_LITERAL(pThis, "@LCL\n");
+    OUT_LITERAL(pThis, "D=M\n");
+    OUT_LITERAL(pThis, "@R13\n");
+    OUT_LITERAL(pThis, "M=D\n");        // FRAME = LCL
 
     for (i = 5; i > 0; i--) {
-        fprintf(pThis->fp, "D=D-1\n");
-    }
-    fprintf(pThis->fp, "A=D\n");
-    fprintf(pThis->fp, "D=M\n");
-    fprintf(pThis->fp, "@R14\n");
-    fprintf(pThis->fp, "M=D\n");        // RET = *(FRAME - 5)
-
-    fprintf(pThis->fp, "@SP\n");
-    fprintf(pThis->fp, "AM=M-1\n");
-    fprintf(pThis->fp, "D=M\n");
-    fprintf(pThis->fp, "@ARG\n");
-    fprintf(pThis->fp, "A=M\n");
-    fprintf(pThis->fp, "M=D\n");        // *ARG = pop()
-
-    fprintf(pThis->fp, "@ARG\n");
-    fprintf(pThis->fp, "D=M\n");
-    fprintf(pThis->fp, "@SP\n");
-    fprintf(pThis->fp, "M=D+1\n");      // SP = ARG + 1
-
-    fprintf(pThis->fp, "@R13\n");
-    fprintf(pThis->fp, "AM=M-1\n");
-    fprintf(pThis->fp, "D=M\n");
-    fprintf(pThis->fp, "@THAT\n");
-    fprintf(pThis->fp, "M=D\n");        // THAT = *(FRAME - 1)
-
-    fprintf(pThis->fp, "@R13\n");
-    fprintf(pThis->fp, "AM=M-1\n");
-    fprintf(pThis->fp, "D=M\n");
-    fprintf(pThis->fp, "@THIS\n");
-    fprintf(pThis->fp, "M=D\n");        // THIS = *(FRAME - 2)
-
-    fprintf(pThis->fp, "@R13\n");
-    fprintf(pThis->fp, "AM=M-1\n");
-    fprintf(pThis->fp, "D=M\n");
-    fprintf(pThis->fp, "@ARG\n");
-    fprintf(pThis->fp, "M=D\n");        // ARG = *(FRAME - 3)
-
-    fprintf(pThis->fp, "@R13\n");
-    fprintf(pThis->fp, "AM=M-1\n");
-    fprintf(pThis->fp, "D=M\n");
-    fprintf(pThis->fp, "@LCL\n");
-    fprintf(pThis->fp, "M=D\n");        // LCL = *(FRAME - 4)
-
-    fprintf(pThis->fp, "@R14\n");
-    fprintf(pThis->fp, "A=M\n");
-    fprintf(pThis->fp, "0;JMP\n");      // goto RET
+        OUT_LITERAL(pThis, "D=D-1\n");
+    }
+    OUT_LITERAL(pThis, "A=D\n");
+    OUT_LITERAL(pThis, "D=M\n");
+    OUT_LITERAL(pThis, "@R14\n");
+    OUT_LITERAL(pThis, "M=D\n");        // RET = *(FRAME - 5)
+
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "AM=M-1\n");
+    OUT_LITERAL(pThis, "D=M\n");
+    OUT_LITERAL(pThis, "@ARG\n");
+    OUT_LITERAL(pThis, "A=M\n");
+    OUT_LITERAL(pThis, "M=D\n");        // *ARG = pop()
+
+    OUT_LITERAL(pThis, "@ARG\n");
+    OUT_LITERAL(pThis, "D=M\n");
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "M=D+1\n");      // SP = ARG + 1
+
+    OUT_LITERAL(pThis, "@R13\n");
+    OUT_LITERAL(pThis, "AM=M-1\n");
+    OUT_LITERAL(pThis, "D=M\n");
+    OUT_LITERAL(pThis, "@THAT\n");
+    OUT_LITERAL(pThis, "M=D\n");        // THAT = *(FRAME - 1)
+
+    OUT_LITERAL(pThis, "@R13\n");
+    OUT_LITERAL(pThis, "AM=M-1\n");
+    OUT_LITERAL(pThis, "D=M\n");
+    OUT_LITERAL(pThis, "@THIS\n");
+    OUT_LITERAL(pThis, "M=D\n");        // THIS = *(FRAME - 2)
+
+    OUT_LITERAL(pThis, "@R13\n");
+    OUT_LITERAL(pThis, "AM=M-1\n");
+    OUT_LITERAL(pThis, "D=M\n");
+    OUT_LITERAL(pThis, "@ARG\n");
+    OUT_LITERAL(pThis, "M=D\n");        // ARG = *(FRAME - 3)
+
+    OUT_LITERAL(pThis, "@R13\n");
+    OUT_LITERAL(pThis, "AM=M-1\n");
+    OUT_LITERAL(pThis, "D=M\n");
+    OUT_LITERAL(pThis, "@LCL\n");
+    OUT_LITERAL(pThis, "M=D\n");        // LCL = *(FRAME - 4)
+
+    OUT_LITERAL(pThis, "@R14\n");
+    OUT_LITERAL(pThis, "A=M\n");
+    OUT_LITERAL(pThis, "0;JMP\n");      // goto RET
 }
 
 void _code_writer_writeFunction(CodeWriter *pThis, char *functionName, int numArgs)
 {
     int i;
 
-    pThis->funcname = functionName;
+    flush_pending(pThis);
+    set_emit_kind(pThis, EMIT_CALL_RETURN);     // counts the previous function's tail
+
+    // the parser reuses its buffer for every command, so keep a copy
+    free(pThis->funcname);
+    pThis->funcname = (char *)malloc(sizeof(char) * strlen(functionName) + 1);
+    strcpy(pThis->funcname, functionName);
+
+    // the assembly of a function depends on nothing but its own commands
+    pThis->ret_num    = 0;
+    pThis->cmp_num    = 0;
+    pThis->inline_num = 0;
+    pThis->math_num   = 0;
 
-    fprintf(pThis->fp, "(%s)\n", functionName);     // (f)
+    out_label(pThis, functionName);                 // (f)
     for (i = 0; i < numArgs; i++) {
-        fprintf(pThis->fp, "@SP\n");
-        fprintf(pThis->fp, "A=M\n");
-        fprintf(pThis->fp, "M=0\n");                // M[SP] = 0
-        fprintf(pThis->fp, "@SP\n");
-        fprintf(pThis->fp, "M=M+1\n");              // ++SP
+        OUT_LITERAL(pThis, "@SP\n");
+        OUT_LITERAL(pThis, "A=M\n");
+        OUT_LITERAL(pThis, "M=0\n");                // M[SP] = 0
+        OUT_LITERAL(pThis, "@SP\n");
+        OUT_LITERAL(pThis, "M=M+1\n");              // ++SP
+    }
+
+    return;
+}
+
+void _code_writer_writeInlineBegin(CodeWriter *pThis, char *functionName, char *filename, int numArgs, int numLocals, bool savePointers)
+{
+    struct inline_frame *frame = &pThis->inline_frame;
+    const char *scope;
+    int i;
+
+    flush_pending(pThis);
+    set_emit_kind(pThis, EMIT_CALL_RETURN);
+
+    frame->active         = true;
+    frame->num_args       = numArgs;
+    frame->num_locals     = numLocals;
+    frame->save_pointers  = savePointers;
+    frame->pending_jump   = false;
+    frame->saved_funcname = pThis->funcname;
+    frame->saved_filename = pThis->filename;
+
+    // labels of the body are scoped to this expansion: (caller$$inline.N$label)
+    scope = label_scope(pThis);
+    pThis->funcname = (char *)malloc(sizeof(char) * strlen(scope) + strlen("$$inline.") + 12);
+    sprintf(pThis->funcname, "%s$$inline.%d", scope, pThis->inline_num);
+    pThis->filename = (char *)malloc(sizeof(char) * strlen(filename) + 1);
+    strcpy(pThis->filename, filename);
+
+    // R15: base of the inline frame (argument 0)
+
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "D=M\n");
+    if (numArgs > 0) {
+        out_at_int(pThis, numArgs);
+        OUT_LITERAL(pThis, "D=D-A\n");
     }
+    OUT_LITERAL(pThis, "@R15\n");
+    OUT_LITERAL(pThis, "M=D\n");                // R15 = SP - numArgs
+
+    for (i = 0; i < numLocals; i++) {
+        OUT_LITERAL(pThis, "@SP\n");
+        OUT_LITERAL(pThis, "A=M\n");
+        OUT_LITERAL(pThis, "M=0\n");            // M[SP] = 0
+        OUT_LITERAL(pThis, "@SP\n");
+        OUT_LITERAL(pThis, "M=M+1\n");          // ++SP
+    }
+
+    if (savePointers) {
+        write_push_with_base_addr(pThis, "3", 0);   // push THIS
+        write_push_with_base_addr(pThis, "3", 1);   // push THAT
+    }
+
+    pThis->inline_num++;
+
+    return;
+}
+
+void _code_writer_writeInlineEnd(CodeWriter *pThis)
+{
+    struct inline_frame *frame = &pThis->inline_frame;
+
+    set_emit_kind(pThis, EMIT_CALL_RETURN);
+
+    // a trailing return falls through to the end label
+    frame->pending_jump = false;
+    out_label(pThis, pThis->funcname);
+
+    free(pThis->funcname);
+    free(pThis->filename);
+    pThis->funcname = frame->saved_funcname;
+    pThis->filename = frame->saved_filename;
+    frame->active = false;
+
+    return;
+}
+
+void _code_writer_writeBuffer(CodeWriter *pThis, CodeWriter *part)
+{
+    out_bytes(pThis, part->out, part->out_len);
+
+    return;
+}
+
+void _code_writer_writeAssembly(CodeWriter *pThis, const char *text, size_t len)
+{
+    flush_pending(pThis);
+    flush_inline_jump(pThis);
+
+    out_bytes(pThis, text, len);
 
     return;
 }
 
 void _code_writer_close(CodeWriter *pThis)
 {
-    fclose(pThis->fp);
+    flush_pending(pThis);
+    count_output(pThis);
+
+    if (pThis->fd == -1) return;
+
+    out_flush(pThis);
+    close(pThis->fd);
 }
 
 void _code_writer_del(CodeWriter *pThis)
 {
-    pThis->fp = NULL;
+    pThis->fd = -1;
+    free(pThis->out);
+    pThis->out = NULL;
     free(pThis->filename);
+    free(pThis->funcname);
+    pThis->funcname = NULL;
+    return;
+}
+
+static void out_write(CodeWriter *pThis, const char *bytes, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(pThis->fd, bytes, len);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
+            exit errno;
+        }
+        bytes += n;
+        len   -= n;
+    }
+
+    return;
+}
+
+static void out_flush(CodeWriter *pThis)
+{
+    count_output(pThis);
+    out_write(pThis, pThis->out, pThis->out_len);
+    pThis->out_len = 0;
+    pThis->stats_mark = 0;
+
+    return;
+}
+
+static void out_bytes(CodeWriter *pThis, const char *bytes, size_t len)
+{
+    if (pThis->out_len + len > pThis->out_size) {
+        if (pThis->fd != -1) {
+            out_flush(pThis);
+
+            // a part bigger than the whole buffer goes straight to the file
+            if (len > pThis->out_size) {
+                out_write(pThis, bytes, len);
+                return;
+            }
+        } else {
+            while (pThis->out_len + len > pThis->out_size)
+                pThis->out_size *= 2;
+            pThis->out = (char *)realloc(pThis->out, sizeof(char) * pThis->out_size);
+        }
+    }
+
+    memcpy(pThis->out + pThis->out_len, bytes, len);
+    pThis->out_len += len;
+
+    return;
+}
+
+static void out_char(CodeWriter *pThis, char ch)
+{
+    if (pThis->out_len == pThis->out_size) {
+        out_bytes(pThis, &ch, 1);
+        return;
+    }
+
+    pThis->out[pThis->out_len++] = ch;
+
+    return;
+}
+
+static void out_str(CodeWriter *pThis, const char *str)
+{
+    out_bytes(pThis, str, strlen(str));
+
+    return;
+}
+
+static void out_int(CodeWriter *pThis, long num)
+{
+    char buf[24];
+    char *p = buf + sizeof(buf);
+    unsigned long n = num < 0 ? -(unsigned long)num : (unsigned long)num;
+
+    // digits are produced from the least significant end
+    do {
+        *--p = '0' + n % 10;
+        n /= 10;
+    } while (n != 0);
+    if (num < 0) *--p = '-';
+
+    out_bytes(pThis, p, buf + sizeof(buf) - p);
+
+    return;
+}
+
+static void out_at_str(CodeWriter *pThis, const char *str)
+{
+    out_char(pThis, '@');
+    out_str(pThis, str);
+    out_char(pThis, '\n');
+
+    return;
+}
+
+static void out_at_int(CodeWriter *pThis, long num)
+{
+    out_char(pThis, '@');
+    out_int(pThis, num);
+    out_char(pThis, '\n');
+
+    return;
+}
+
+static void out_label(CodeWriter *pThis, const char *str)
+{
+    out_char(pThis, '(');
+    out_str(pThis, str);
+    OUT_LITERAL(pThis, ")\n");
+
+    return;
+}
+
+// generated labels are numbered per function and carry its name (the
+// caller's while a body is inlined); commands outside of any function
+// use the file name instead. They follow the name with "$$", which a VM
+// label cannot start with, so they never meet a label of the program
+static const char *label_scope(CodeWriter *pThis)
+{
+    char *funcname = pThis->funcname, *filename = pThis->filename;
+
+    if (pThis->inline_frame.active) {
+        funcname = pThis->inline_frame.saved_funcname;
+        filename = pThis->inline_frame.saved_filename;
+    }
+
+    if (funcname != NULL) return funcname;
+    if (filename != NULL) return filename;
+
+    return "null";
+}
+
+static void out_scope(CodeWriter *pThis)
+{
+    out_str(pThis, label_scope(pThis));
+    OUT_LITERAL(pThis, "$$");
+
+    return;
+}
+
+static void out_jump_label(CodeWriter *pThis, const char *label)
+{
+    out_char(pThis, '@');
+    out_str(pThis, pThis->funcname ? pThis->funcname : "null");
+    out_char(pThis, '$');
+    out_str(pThis, label);
+    out_char(pThis, '\n');
+
     return;
 }
 
 
 static void write_unary_function_code(CodeWriter *pThis, const char *assemble)
 {
-    fprintf(pThis->fp, "@SP\n");
-    fprintf(pThis->fp, "A=M-1\n");
-    fprintf(pThis->fp, "%s\n", assemble);
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "A=M-1\n");
+    out_str(pThis, assemble); out_char(pThis, '\n');
 
     return;
 }
 
 static void write_binary_function_code(CodeWriter *pThis, const char *assemble)
 {
-    fprintf(pThis->fp, "@SP\n");
-    fprintf(pThis->fp, "AM=M-1\n");         // --SP
-    fprintf(pThis->fp, "D=M\n");            // D = M[SP]
-    fprintf(pThis->fp, "A=A-1\n");
-    fprintf(pThis->fp, "%s\n", assemble);
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "AM=M-1\n");         // --SP
+    OUT_LITERAL(pThis, "D=M\n");            // D = M[SP]
+    OUT_LITERAL(pThis, "A=A-1\n");
+    out_str(pThis, assemble); out_char(pThis, '\n');
 
     return;
 }
 
 static void write_compare_function_code(CodeWriter *pThis, const char *assemble)
 {
-    static unsigned long cnt = 0;
-
-    fprintf(pThis->fp, "@SP\n");                    // --SP
-    fprintf(pThis->fp, "AM=M-1\n");
-    fprintf(pThis->fp, "D=M\n");                    // D=M[SP]
-    fprintf(pThis->fp, "A=A-1\n");
-    fprintf(pThis->fp, "D=M-D\n");                  // M[SP-1] - D
-    fprintf(pThis->fp, "@TRUE%lu\n", cnt);
-    fprintf(pThis->fp, "D;%s\n", assemble);
-    fprintf(pThis->fp, "@SP\n");                    // if false
-    fprintf(pThis->fp, "A=M-1\n");
-    fprintf(pThis->fp, "M=0\n");                    // M[SP-1] = 0
-    fprintf(pThis->fp, "@CONTINUE%lu\n", cnt);      // go to end if
-    fprintf(pThis->fp, "0;JMP\n");
-    fprintf(pThis->fp, "(TRUE%lu)\n", cnt);         // if true
-    fprintf(pThis->fp, "@SP\n");
-    fprintf(pThis->fp, "A=M-1\n");
-    fprintf(pThis->fp, "M=-1\n");                   // M[SP-1] = -1
-    fprintf(pThis->fp, "(CONTINUE%lu)\n", cnt);     // end if
-
-    cnt++;
+    OUT_LITERAL(pThis, "@SP\n");                    // --SP
+    OUT_LITERAL(pThis, "AM=M-1\n");
+    OUT_LITERAL(pThis, "D=M\n");                    // D=M[SP]
+    OUT_LITERAL(pThis, "A=A-1\n");
+    OUT_LITERAL(pThis, "D=M-D\n");                  // M[SP-1] - D
+    out_char(pThis, '@'); out_scope(pThis); OUT_LITERAL(pThis, "TRUE."); out_int(pThis, pThis->cmp_num); out_char(pThis, '\n');
+    OUT_LITERAL(pThis, "D;"); out_str(pThis, assemble); out_char(pThis, '\n');
+    OUT_LITERAL(pThis, "@SP\n");                    // if false
+    OUT_LITERAL(pThis, "A=M-1\n");
+    OUT_LITERAL(pThis, "M=0\n");                    // M[SP-1] = 0
+    out_char(pThis, '@'); out_scope(pThis); OUT_LITERAL(pThis, "CONTINUE."); out_int(pThis, pThis->cmp_num); out_char(pThis, '\n');     // go to end if
+    OUT_LITERAL(pThis, "0;JMP\n");
+    out_char(pThis, '('); out_scope(pThis); OUT_LITERAL(pThis, "TRUE."); out_int(pThis, pThis->cmp_num); OUT_LITERAL(pThis, ")\n");          // if true
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "A=M-1\n");
+    OUT_LITERAL(pThis, "M=-1\n");                   // M[SP-1] = -1
+    out_char(pThis, '('); out_scope(pThis); OUT_LITERAL(pThis, "CONTINUE."); out_int(pThis, pThis->cmp_num); OUT_LITERAL(pThis, ")\n");      // end if
+
+    pThis->cmp_num++;
     return;
 }
 
-static void write_push_code(CodeWriter *pThis, const char *segment, int index)
+static void write_push_code(CodeWriter *pThis, enum segmentType segment, int index)
 {
     static const struct push_pop_conv_list conv_list[] = {
-        {"constant", NULL,   write_push_constant},
-        {"local",    "LCL",  write_push_with_base_regs},
-        {"argument", "ARG",  write_push_with_base_regs},
-        {"this",     "THIS", write_push_with_base_regs},
-        {"that",     "THAT", write_push_with_base_regs},
-        {"pointer",  "3",    write_push_with_base_addr},
-        {"temp",     "5",    write_push_with_base_addr},
-        {"static",   NULL,   write_push_static},
-        {NULL,       NULL,   NULL},
+        {S_CONSTANT, NULL,   write_push_constant},
+        {S_LOCAL,    "LCL",  write_push_with_base_regs},
+        {S_ARGUMENT, "ARG",  write_push_with_base_regs},
+        {S_THIS,     "THIS", write_push_with_base_regs},
+        {S_THAT,     "THAT", write_push_with_base_regs},
+        {S_POINTER,  "3",    write_push_with_base_addr},
+        {S_TEMP,     "5",    write_push_with_base_addr},
+        {S_STATIC,   NULL,   write_push_static},
+        {S_OTHER,    NULL,   NULL},
     };
 
     int i;
 
-    for (i = 0; conv_list[i].segment != NULL; i++) {
-        if (!strcmp(segment, conv_list[i].segment)) {
+    for (i = 0; conv_list[i].segment != S_OTHER; i++) {
+        if (segment == conv_list[i].segment) {
             conv_list[i].write_code_template(pThis, conv_list[i].label, index);
         }
     }
@@ -355,76 +826,76 @@ static void write_push_code(CodeWriter *pThis, const char *segment, int index)
 
 static void write_push_constant(CodeWriter *pThis, const char *regs, int index)
 {
-    fprintf(pThis->fp, "@%d\n", index);
-    fprintf(pThis->fp, "D=A\n");            // D = index
-    fprintf(pThis->fp, "@SP\n");
-    fprintf(pThis->fp, "A=M\n");
-    fprintf(pThis->fp, "M=D\n");            // M[SP] = D
-    fprintf(pThis->fp, "@SP\n");
-    fprintf(pThis->fp, "M=M+1\n");          // ++SP
+    out_at_int(pThis, index);
+    OUT_LITERAL(pThis, "D=A\n");            // D = index
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "A=M\n");
+    OUT_LITERAL(pThis, "M=D\n");            // M[SP] = D
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "M=M+1\n");          // ++SP
 
     return;
 }
 
 static void write_push_with_base_regs(CodeWriter *pThis, const char *regs, int index)
 {
-    fprintf(pThis->fp, "@%s\n", regs);
-    fprintf(pThis->fp, "D=M\n");            // D = base
-    fprintf(pThis->fp, "@%d\n", index);
-    fprintf(pThis->fp, "A=D+A\n");          // A = base + index
-    fprintf(pThis->fp, "D=M\n");            // D = M[base + index]
-    fprintf(pThis->fp, "@SP\n");
-    fprintf(pThis->fp, "A=M\n");
-    fprintf(pThis->fp, "M=D\n");            // M[SP] = D
-    fprintf(pThis->fp, "@SP\n");
-    fprintf(pThis->fp, "M=M+1\n");          // ++SP
+    out_at_str(pThis, regs);
+    OUT_LITERAL(pThis, "D=M\n");            // D = base
+    out_at_int(pThis, index);
+    OUT_LITERAL(pThis, "A=D+A\n");          // A = base + index
+    OUT_LITERAL(pThis, "D=M\n");            // D = M[base + index]
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "A=M\n");
+    OUT_LITERAL(pThis, "M=D\n");            // M[SP] = D
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "M=M+1\n");          // ++SP
 
     return;
 }
 
 static void write_push_with_base_addr(CodeWriter *pThis, const char *addr, int index)
 {
-    fprintf(pThis->fp, "@%d\n", atoi(addr) + index);
-    fprintf(pThis->fp, "D=M\n");            // D = M[3 + index]
-    fprintf(pThis->fp, "@SP\n");
-    fprintf(pThis->fp, "A=M\n");
-    fprintf(pThis->fp, "M=D\n");            // M[SP] = D
-    fprintf(pThis->fp, "@SP\n");
-    fprintf(pThis->fp, "M=M+1\n");          // ++SP
+    out_at_int(pThis, atoi(addr) + index);
+    OUT_LITERAL(pThis, "D=M\n");            // D = M[3 + index]
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "A=M\n");
+    OUT_LITERAL(pThis, "M=D\n");            // M[SP] = D
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "M=M+1\n");          // ++SP
 
     return;
 }
 
 static void write_push_static(CodeWriter *pThis, const char *addr, int index)
 {
-    fprintf(pThis->fp, "@%s.%d\n", pThis->filename, index);
-    fprintf(pThis->fp, "D=M\n");            // D = M[3 + index]
-    fprintf(pThis->fp, "@SP\n");
-    fprintf(pThis->fp, "A=M\n");
-    fprintf(pThis->fp, "M=D\n");            // M[SP] = D
-    fprintf(pThis->fp, "@SP\n");
-    fprintf(pThis->fp, "M=M+1\n");          // ++SP
+    out_char(pThis, '@'); out_str(pThis, pThis->filename); out_char(pThis, '.'); out_int(pThis, index); out_char(pThis, '\n');
+    OUT_LITERAL(pThis, "D=M\n");            // D = M[3 + index]
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "A=M\n");
+    OUT_LITERAL(pThis, "M=D\n");            // M[SP] = D
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "M=M+1\n");          // ++SP
 
     return;
 }
 
-static void write_pop_code(CodeWriter *pThis, const char *segment, int index)
+static void write_pop_code(CodeWriter *pThis, enum segmentType segment, int index)
 {
     static const struct push_pop_conv_list conv_list[] = {
-        {"local",    "LCL",  write_pop_with_base_regs},
-        {"argument", "ARG",  write_pop_with_base_regs},
-        {"this",     "THIS", write_pop_with_base_regs},
-        {"that",     "THAT", write_pop_with_base_regs},
-        {"pointer",  "3",    write_pop_with_base_addr},
-        {"temp",     "5",    write_pop_with_base_addr},
-        {"static",   NULL,   write_pop_static},
-        {NULL,       NULL,   NULL},
+        {S_LOCAL,    "LCL",  write_pop_with_base_regs},
+        {S_ARGUMENT, "ARG",  write_pop_with_base_regs},
+        {S_THIS,     "THIS", write_pop_with_base_regs},
+        {S_THAT,     "THAT", write_pop_with_base_regs},
+        {S_POINTER,  "3",    write_pop_with_base_addr},
+        {S_TEMP,     "5",    write_pop_with_base_addr},
+        {S_STATIC,   NULL,   write_pop_static},
+        {S_OTHER,    NULL,   NULL},
     };
 
     int i;
 
-    for (i = 0; conv_list[i].segment != NULL; i++) {
-        if (!strcmp(segment, conv_list[i].segment)) {
+    for (i = 0; conv_list[i].segment != S_OTHER; i++) {
+        if (segment == conv_list[i].segment) {
             conv_list[i].write_code_template(pThis, conv_list[i].label, index);
         }
     }
@@ -434,44 +905,773 @@ static void write_pop_code(CodeWriter *pThis, const char *segment, int index)
 
 static void write_pop_with_base_regs(CodeWriter *pThis, const char *regs, int index)
 {
-    fprintf(pThis->fp, "@%s\n", regs);
-    fprintf(pThis->fp, "D=M\n");            // D = base
-    fprintf(pThis->fp, "@%d\n", index);
-    fprintf(pThis->fp, "D=D+A\n");          // D = base + index
-    fprintf(pThis->fp, "@R13\n");
-    fprintf(pThis->fp, "M=D\n");            // M[R13] = D
+    out_at_str(pThis, regs);
+    OUT_LITERAL(pThis, "D=M\n");            // D = base
+    out_at_int(pThis, index);
+    OUT_LITERAL(pThis, "D=D+A\n");          // D = base + index
+    OUT_LITERAL(pThis, "@R13\n");
+    OUT_LITERAL(pThis, "M=D\n");            // M[R13] = D
 
-    fprintf(pThis->fp, "@SP\n");
-    fprintf(pThis->fp, "AM=M-1\n");         // --SP
-    fprintf(pThis->fp, "D=M\n");            // D = M[SP]
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "AM=M-1\n");         // --SP
+    OUT_LITERAL(pThis, "D=M\n");            // D = M[SP]
 
-    fprintf(pThis->fp, "@R13\n");
-    fprintf(pThis->fp, "A=M\n");            // A = base + index
-    fprintf(pThis->fp, "M=D\n");            // M[base + index] = D
+    OUT_LITERAL(pThis, "@R13\n");
+    OUT_LITERAL(pThis, "A=M\n");            // A = base + index
+    OUT_LITERAL(pThis, "M=D\n");            // M[base + index] = D
 
     return;
 }
 
 static void write_pop_with_base_addr(CodeWriter *pThis, const char *addr, int index)
 {
-    fprintf(pThis->fp, "@SP\n");
-    fprintf(pThis->fp, "AM=M-1\n");         // --SP
-    fprintf(pThis->fp, "D=M\n");            // D = M[SP]
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "AM=M-1\n");         // --SP
+    OUT_LITERAL(pThis, "D=M\n");            // D = M[SP]
 
-    fprintf(pThis->fp, "@%d\n", atoi(addr) + index);
-    fprintf(pThis->fp, "M=D\n");            // M[base + index] = D
+    out_at_int(pThis, atoi(addr) + index);
+    OUT_LITERAL(pThis, "M=D\n");            // M[base + index] = D
 
     return;
 }
 
 static void write_pop_static(CodeWriter *pThis, const char *addr, int index)
 {
-    fprintf(pThis->fp, "@SP\n");
-    fprintf(pThis->fp, "AM=M-1\n");         // --SP
-    fprintf(pThis->fp, "D=M\n");            // D = M[SP]
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "AM=M-1\n");         // --SP
+    OUT_LITERAL(pThis, "D=M\n");            // D = M[SP]
+
+    out_char(pThis, '@'); out_str(pThis, pThis->filename); out_char(pThis, '.'); out_int(pThis, index); out_char(pThis, '\n');
+    OUT_LITERAL(pThis, "M=D\n");            // M[base + index] = D
+
+    return;
+}
+
+static void write_push_inline(CodeWriter *pThis, int offset)
+{
+    OUT_LITERAL(pThis, "@R15\n");
+    OUT_LITERAL(pThis, "D=M\n");            // D = base
+    out_at_int(pThis, offset);
+    OUT_LITERAL(pThis, "A=D+A\n");          // A = base + offset
+    OUT_LITERAL(pThis, "D=M\n");            // D = M[base + offset]
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "A=M\n");
+    OUT_LITERAL(pThis, "M=D\n");            // M[SP] = D
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "M=M+1\n");          // ++SP
+
+    return;
+}
+
+static void write_pop_inline(CodeWriter *pThis, int offset)
+{
+    OUT_LITERAL(pThis, "@R15\n");
+    OUT_LITERAL(pThis, "D=M\n");            // D = base
+    out_at_int(pThis, offset);
+    OUT_LITERAL(pThis, "D=D+A\n");          // D = base + offset
+    OUT_LITERAL(pThis, "@R13\n");
+    OUT_LITERAL(pThis, "M=D\n");            // M[R13] = D
+
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "AM=M-1\n");         // --SP
+    OUT_LITERAL(pThis, "D=M\n");            // D = M[SP]
+
+    OUT_LITERAL(pThis, "@R13\n");
+    OUT_LITERAL(pThis, "A=M\n");            // A = base + offset
+    OUT_LITERAL(pThis, "M=D\n");            // M[base + offset] = D
+
+    return;
+}
+
+static void write_inline_return(CodeWriter *pThis)
+{
+    struct inline_frame *frame = &pThis->inline_frame;
+    int saved = frame->num_args + frame->num_locals;
+
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "AM=M-1\n");
+    OUT_LITERAL(pThis, "D=M\n");            // D = pop()
+
+    if (frame->save_pointers) {
+        OUT_LITERAL(pThis, "@R13\n");
+        OUT_LITERAL(pThis, "M=D\n");        // R13 = return value
+
+        OUT_LITERAL(pThis, "@R15\n");
+        OUT_LITERAL(pThis, "D=M\n");
+        out_at_int(pThis, saved);
+        OUT_LITERAL(pThis, "A=D+A\n");
+        OUT_LITERAL(pThis, "D=M\n");
+        OUT_LITERAL(pThis, "@THIS\n");
+        OUT_LITERAL(pThis, "M=D\n");        // restore THIS
+
+        OUT_LITERAL(pThis, "@R15\n");
+        OUT_LITERAL(pThis, "D=M\n");
+        out_at_int(pThis, saved + 1);
+        OUT_LITERAL(pThis, "A=D+A\n");
+        OUT_LITERAL(pThis, "D=M\n");
+        OUT_LITERAL(pThis, "@THAT\n");
+        OUT_LITERAL(pThis, "M=D\n");        // restore THAT
+
+        OUT_LITERAL(pThis, "@R13\n");
+        OUT_LITERAL(pThis, "D=M\n");
+    }
+
+    OUT_LITERAL(pThis, "@R15\n");
+    OUT_LITERAL(pThis, "A=M\n");
+    OUT_LITERAL(pThis, "M=D\n");            // M[base] = return value
+    OUT_LITERAL(pThis, "@R15\n");
+    OUT_LITERAL(pThis, "D=M+1\n");
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "M=D\n");            // SP = base + 1
+
+    frame->pending_jump = true;
+
+    return;
+}
+
+static void flush_inline_jump(CodeWriter *pThis)
+{
+    if (!pThis->inline_frame.pending_jump) return;
+
+    out_at_str(pThis, pThis->funcname);
+    OUT_LITERAL(pThis, "0;JMP\n");         // goto end of inlined body
+    pThis->inline_frame.pending_jump = false;
+
+    return;
+}
+
+static bool fusing(CodeWriter *pThis)
+{
+    // inlined bodies address their frame through R15, so they are left alone
+    return pThis->fuse && !pThis->inline_frame.active;
+}
+
+static bool holding(CodeWriter *pThis)
+{
+    return (pThis->fuse || pThis->lower_math) && !pThis->inline_frame.active;
+}
+
+static void queue_command(CodeWriter *pThis, enum commandType type, enum segmentType segment, int index)
+{
+    enum fuseMatch match;
+
+    // the longest prefix only completes at an if-goto, which is not queued
+    if (pThis->num_pending == FUSE_MAX_PENDING)
+        emit_pending(pThis, 1);
+
+    pThis->pending[pThis->num_pending].type    = type;
+    pThis->pending[pThis->num_pending].segment = segment;
+    pThis->pending[pThis->num_pending].index   = index;
+    pThis->num_pending++;
+
+    while (pThis->num_pending > 0) {
+        match = match_pending(pThis);
+
+        if (match == FUSE_PREFIX) return;
+
+        if (match == FUSE_NONE) {
+            // the oldest command can't start a sequence; the rest still might
+            emit_pending(pThis, 1);
+            continue;
+        }
+
+        write_fused_code(pThis, match);
+        pThis->num_pending = 0;
+    }
+
+    return;
+}
+
+static void flush_pending(CodeWriter *pThis)
+{
+    emit_pending(pThis, pThis->num_pending);
+
+    return;
+}
+
+static void emit_pending(CodeWriter *pThis, int num)
+{
+    struct fuse_command *c;
+    int i;
+
+    for (i = 0; i < num; i++) {
+        c = &pThis->pending[i];
+        if (c->type == C_ARITHMETRIC)
+            write_arithmetic_code(pThis, c->index);
+        else
+            write_push_pop_code(pThis, c->type, c->segment, c->index);
+    }
+
+    for (i = num; i < pThis->num_pending; i++)
+        pThis->pending[i - num] = pThis->pending[i];
+    pThis->num_pending -= num;
+
+    return;
+}
+
+static bool is_push(struct fuse_command *c)
+{
+    return c->type == C_PUSH;
+}
+
+static bool is_push_constant(struct fuse_command *c)
+{
+    return c->type == C_PUSH && c->segment == S_CONSTANT;
+}
+
+static bool is_pop(struct fuse_command *c)
+{
+    return c->type == C_POP && c->segment != S_CONSTANT;
+}
+
+static bool is_operator(struct fuse_command *c, int op)
+{
+    return c->type == C_ARITHMETRIC && c->index == op;
+}
+
+static bool is_binary(struct fuse_command *c)
+{
+    return is_operator(c, AR_ADD) || is_operator(c, AR_SUB) || is_operator(c, AR_AND) || is_operator(c, AR_OR);
+}
+
+static bool is_compare(struct fuse_command *c)
+{
+    return is_operator(c, AR_EQ) || is_operator(c, AR_GT) || is_operator(c, AR_LT);
+}
+
+static enum fuseMatch match_pending(CodeWriter *pThis)
+{
+    struct fuse_command *c = pThis->pending;
+    int last = pThis->num_pending - 1;
+
+    // a constant operand waits to see whether Math.multiply or Math.divide follows
+    if (pThis->lower_math) {
+        if (is_push_constant(&c[last]))
+            return FUSE_PREFIX;
+        if (last > 0 && is_push_constant(&c[last - 1]) && is_push(&c[last]))
+            return FUSE_PREFIX;
+    }
+
+    if (!pThis->fuse) return FUSE_NONE;
+
+    switch (pThis->num_pending) {
+        case 1:
+            if (is_push(&c[0]) || is_binary(&c[0]) || is_compare(&c[0]) || is_operator(&c[0], AR_NOT))
+                return FUSE_PREFIX;
+            break;
+        case 2:
+            if (is_push(&c[0]) && is_pop(&c[1]))
+                return FUSE_MOVE;
+            if (is_push(&c[0]) && is_binary(&c[1]))
+                return FUSE_PUSH_BINARY;
+            if (is_push_constant(&c[0]) && is_operator(&c[1], AR_NEG))
+                return FUSE_PUSH_NEG_CONSTANT;
+            if (is_binary(&c[0]) && is_pop(&c[1]))
+                return FUSE_BINARY_POP;
+            if (is_push(&c[0]) && (is_push_constant(&c[1]) || is_compare(&c[1])))
+                return FUSE_PREFIX;
+            if (is_compare(&c[0]) && is_operator(&c[1], AR_NOT))
+                return FUSE_PREFIX;
+            break;
+        case 3:
+            if (is_push(&c[0]) && is_push_constant(&c[1]) && (is_operator(&c[2], AR_ADD) || is_operator(&c[2], AR_SUB)))
+                return FUSE_PUSH_ADD_CONSTANT;
+            if (is_push(&c[0]) && is_compare(&c[1]) && is_operator(&c[2], AR_NOT))
+                return FUSE_PREFIX;
+            break;
+        default:
+            break;
+    }
+
+    return FUSE_NONE;
+}
+
+static void write_fused_code(CodeWriter *pThis, enum fuseMatch match)
+{
+    struct fuse_command *c = pThis->pending;
+    int constant;
+
+    set_emit_kind(pThis, EMIT_FUSED);
+    flush_inline_jump(pThis);
+
+    switch (match) {
+        case FUSE_MOVE:
+            write_store_d_begin(pThis, c[1].segment, c[1].index);
+            write_load_d(pThis, c[0].segment, c[0].index);
+            write_store_d_end(pThis, c[1].segment, c[1].index);
+            break;
+        case FUSE_PUSH_BINARY:
+            write_load_d(pThis, c[0].segment, c[0].index);
+            OUT_LITERAL(pThis, "@SP\n");
+            OUT_LITERAL(pThis, "A=M-1\n");
+            if (c[1].index == AR_ADD)
+                OUT_LITERAL(pThis, "M=D+M\n");
+            else if (c[1].index == AR_SUB)
+                OUT_LITERAL(pThis, "M=M-D\n");
+            else if (c[1].index == AR_AND)
+                OUT_LITERAL(pThis, "M=D&M\n");
+            else
+                OUT_LITERAL(pThis, "M=D|M\n");
+            break;
+        case FUSE_PUSH_ADD_CONSTANT:
+            constant = c[1].index;
+            write_load_d(pThis, c[0].segment, c[0].index);
+            if (constant == 1) {
+                if (c[2].index == AR_ADD)
+                    OUT_LITERAL(pThis, "D=D+1\n");
+                else
+                    OUT_LITERAL(pThis, "D=D-1\n");
+            } else if (constant != 0) {
+                out_at_int(pThis, constant);
+                if (c[2].index == AR_ADD)
+                    OUT_LITERAL(pThis, "D=D+A\n");
+                else
+                    OUT_LITERAL(pThis, "D=D-A\n");
+            }
+            write_push_d(pThis);
+            break;
+        case FUSE_PUSH_NEG_CONSTANT:
+            out_at_int(pThis, c[0].index);
+            OUT_LITERAL(pThis, "D=-A\n");
+            write_push_d(pThis);
+            break;
+        case FUSE_BINARY_POP:
+            write_store_d_begin(pThis, c[1].segment, c[1].index);
+            OUT_LITERAL(pThis, "@SP\n");
+            OUT_LITERAL(pThis, "AM=M-1\n");
+            OUT_LITERAL(pThis, "D=M\n");            // D = y
+            OUT_LITERAL(pThis, "@SP\n");
+            OUT_LITERAL(pThis, "AM=M-1\n");         // M = x
+            if (c[0].index == AR_ADD)
+                OUT_LITERAL(pThis, "D=D+M\n");
+            else if (c[0].index == AR_SUB)
+                OUT_LITERAL(pThis, "D=M-D\n");
+            else if (c[0].index == AR_AND)
+                OUT_LITERAL(pThis, "D=D&M\n");
+            else
+                OUT_LITERAL(pThis, "D=D|M\n");
+            write_store_d_end(pThis, c[1].segment, c[1].index);
+            break;
+        default:
+            break;
+    }
+
+    return;
+}
+
+// if-goto consumes the value on top of the stack, so a condition that is
+// still pending never has to be stored; the jump tests it directly
+static bool write_fused_if(CodeWriter *pThis, char *label)
+{
+    static const char *jumps[][2] = {
+        [AR_EQ] = {"D;JEQ\n", "D;JNE\n"},
+        [AR_GT] = {"D;JGT\n", "D;JLE\n"},
+        [AR_LT] = {"D;JLT\n", "D;JGE\n"},
+    };
+
+    struct fuse_command *c = pThis->pending;
+    struct fuse_command *compare = NULL;
+    bool load = false, negate = false;
+    int n;
+
+    while ((n = pThis->num_pending) > 0) {
+        load = is_push(&c[0]);
+        compare = NULL;
+        negate = false;
+
+        if (n == 1 && load) break;
+        if (n == 1 && is_operator(&c[0], AR_NOT)) {
+            negate = true;
+            break;
+        }
+        if (n == 1 && is_compare(&c[0])) {
+            compare = &c[0];
+            break;
+        }
+        if (n == 2 && load && is_compare(&c[1])) {
+            compare = &c[1];
+            break;
+        }
+        if (n == 2 && is_compare(&c[0]) && is_operator(&c[1], AR_NOT)) {
+            compare = &c[0];
+            negate = true;
+            break;
+        }
+        if (n == 3 && load && is_compare(&c[1]) && is_operator(&c[2], AR_NOT)) {
+            compare = &c[1];
+            negate = true;
+            break;
+        }
+
+        emit_pending(pThis, 1);
+    }
+
+    if (n == 0) return false;
+
+    set_emit_kind(pThis, EMIT_FUSED);
+    flush_inline_jump(pThis);
+
+    if (load)
+        write_load_d(pThis, c[0].segment, c[0].index);      // D = y
+
+    if (compare != NULL) {
+        if (!load) {
+            OUT_LITERAL(pThis, "@SP\n");
+            OUT_LITERAL(pThis, "AM=M-1\n");
+            OUT_LITERAL(pThis, "D=M\n");                    // D = y
+        }
+        OUT_LITERAL(pThis, "@SP\n");
+        OUT_LITERAL(pThis, "AM=M-1\n");
+        OUT_LITERAL(pThis, "D=M-D\n");                      // D = x - y
+        out_jump_label(pThis, label);
+        out_str(pThis, jumps[compare->index][negate]);
+    } else if (negate) {
+        OUT_LITERAL(pThis, "@SP\n");
+        OUT_LITERAL(pThis, "AM=M-1\n");
+        OUT_LITERAL(pThis, "D=M+1\n");                      // !x is true unless x is -1
+        out_jump_label(pThis, label);
+        OUT_LITERAL(pThis, "D;JNE\n");
+    } else {
+        out_jump_label(pThis, label);
+        OUT_LITERAL(pThis, "D;JNE\n");
+    }
+
+    pThis->num_pending = 0;
+
+    return true;
+}
+
+static void write_load_d(CodeWriter *pThis, enum segmentType segment, int index)
+{
+    switch (segment) {
+        case S_CONSTANT:
+            if (index == 0) {
+                OUT_LITERAL(pThis, "D=0\n");
+            } else if (index == 1) {
+                OUT_LITERAL(pThis, "D=1\n");
+            } else {
+                out_at_int(pThis, index);
+                OUT_LITERAL(pThis, "D=A\n");
+            }
+            break;
+        case S_LOCAL:
+        case S_ARGUMENT:
+        case S_THIS:
+        case S_THAT:
+            out_at_str(pThis, base_regs[segment]);
+            if (index == 0) {
+                OUT_LITERAL(pThis, "A=M\n");
+            } else {
+                OUT_LITERAL(pThis, "D=M\n");
+                out_at_int(pThis, index);
+                OUT_LITERAL(pThis, "A=D+A\n");
+            }
+            OUT_LITERAL(pThis, "D=M\n");
+            break;
+        case S_POINTER:
+            out_at_int(pThis, 3 + index);
+            OUT_LITERAL(pThis, "D=M\n");
+            break;
+        case S_TEMP:
+            out_at_int(pThis, 5 + index);
+            OUT_LITERAL(pThis, "D=M\n");
+            break;
+        case S_STATIC:
+            out_char(pThis, '@'); out_str(pThis, pThis->filename); out_char(pThis, '.'); out_int(pThis, index); out_char(pThis, '\n');
+            OUT_LITERAL(pThis, "D=M\n");
+            break;
+        default:
+            break;
+    }
+
+    return;
+}
+
+static void write_store_d_begin(CodeWriter *pThis, enum segmentType segment, int index)
+{
+    if (segment < S_LOCAL || segment > S_THAT || index <= STORE_WALK_MAX) return;
+
+    out_at_str(pThis, base_regs[segment]);
+    OUT_LITERAL(pThis, "D=M\n");
+    out_at_int(pThis, index);
+    OUT_LITERAL(pThis, "D=D+A\n");
+    OUT_LITERAL(pThis, "@R13\n");
+    OUT_LITERAL(pThis, "M=D\n");            // R13 = base + index
+
+    return;
+}
+
+static void write_store_d_end(CodeWriter *pThis, enum segmentType segment, int index)
+{
+    int i;
+
+    switch (segment) {
+        case S_LOCAL:
+        case S_ARGUMENT:
+        case S_THIS:
+        case S_THAT:
+            if (index > STORE_WALK_MAX) {
+                OUT_LITERAL(pThis, "@R13\n");
+                OUT_LITERAL(pThis, "A=M\n");
+            } else {
+                out_at_str(pThis, base_regs[segment]);
+                OUT_LITERAL(pThis, "A=M\n");
+                for (i = 0; i < index; i++)
+                    OUT_LITERAL(pThis, "A=A+1\n");
+            }
+            OUT_LITERAL(pThis, "M=D\n");
+            break;
+        case S_POINTER:
+            out_at_int(pThis, 3 + index);
+            OUT_LITERAL(pThis, "M=D\n");
+            break;
+        case S_TEMP:
+            out_at_int(pThis, 5 + index);
+            OUT_LITERAL(pThis, "M=D\n");
+            break;
+        case S_STATIC:
+            out_char(pThis, '@'); out_str(pThis, pThis->filename); out_char(pThis, '.'); out_int(pThis, index); out_char(pThis, '\n');
+            OUT_LITERAL(pThis, "M=D\n");
+            break;
+        default:
+            break;
+    }
+
+    return;
+}
+
+static void write_push_d(CodeWriter *pThis)
+{
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "M=M+1\n");          // ++SP
+    OUT_LITERAL(pThis, "A=M-1\n");
+    OUT_LITERAL(pThis, "M=D\n");            // M[SP - 1] = D
+
+    return;
+}
+
+// Math.multiply by a constant and Math.divide by a power of two, written
+// in place of the call; the stack effect and the result are the same
+static bool write_lowered_math(CodeWriter *pThis, char *functionName, int numArgs)
+{
+    struct fuse_command *c = pThis->pending;
+    int last = pThis->num_pending - 1, constant, shift;
+
+    if (!pThis->lower_math || pThis->inline_frame.active || numArgs != 2 || last < 0) return false;
+
+    if (!strcmp(functionName, "Math.multiply")) {
+        if (is_push_constant(&c[last])) {
+            constant = c[last].index;
+        } else if (last > 0 && is_push_constant(&c[last - 1]) && is_push(&c[last])) {
+            // k * x: x takes the place of k on the stack
+            constant = c[last - 1].index;
+            c[last - 1] = c[last];
+        } else {
+            return false;
+        }
+        pThis->num_pending--;
+        flush_pending(pThis);
+        write_multiply_constant(pThis, constant);
+        return true;
+    }
+
+    if (!strcmp(functionName, "Math.divide")) {
+        if (!is_push_constant(&c[last])) return false;
+        constant = c[last].index;
+        if (constant <= 0 || (constant & (constant - 1)) != 0) return false;
+        for (shift = 0; (1 << shift) < constant; shift++)
+            ;
+        pThis->num_pending--;
+        flush_pending(pThis);
+        write_divide_power(pThis, shift);
+        return true;
+    }
+
+    return false;
+}
+
+// Horner's rule over the bits of the constant; like the OS routine the
+// product wraps around at 16 bits
+static void write_multiply_constant(CodeWriter *pThis, int constant)
+{
+    int top, bit;
+
+    if (constant == 1) return;
+
+    set_emit_kind(pThis, EMIT_ARITHMETIC);
+    flush_inline_jump(pThis);
+
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "A=M-1\n");
+    if (constant == 0) {
+        OUT_LITERAL(pThis, "M=0\n");
+        return;
+    }
+    OUT_LITERAL(pThis, "D=M\n");            // D = x
+
+    for (top = 1; top <= constant / 2; top <<= 1)
+        ;
+
+    if (top == constant) {
+        for (bit = top; bit > 1; bit >>= 1)
+            OUT_LITERAL(pThis, "MD=D+M\n"); // M[SP - 1] = 2 * M[SP - 1]
+        return;
+    }
+
+    OUT_LITERAL(pThis, "@R14\n");
+    OUT_LITERAL(pThis, "M=D\n");            // R14 = x
+    OUT_LITERAL(pThis, "@R13\n");
+    OUT_LITERAL(pThis, "M=D\n");            // R13 = x, for the highest bit
+    for (bit = top >> 1; bit > 0; bit >>= 1) {
+        OUT_LITERAL(pThis, "MD=D+M\n");     // R13 = 2 * R13
+        if (constant & bit) {
+            OUT_LITERAL(pThis, "@R14\n");
+            OUT_LITERAL(pThis, "D=D+M\n");
+            OUT_LITERAL(pThis, "@R13\n");
+            OUT_LITERAL(pThis, "M=D\n");    // R13 = R13 + x
+        }
+    }
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "A=M-1\n");
+    OUT_LITERAL(pThis, "M=D\n");            // M[SP - 1] = R13
+
+    return;
+}
+
+// Math.divide(x, 2^shift) as 12/Math.jack computes it: |x| >> shift with
+// the sign put back, except that a negative odd quotient comes out 2 too
+// high and -32768 divided by an odd power of two is positive
+static void write_divide_power(CodeWriter *pThis, int shift)
+{
+    int num = pThis->math_num++;
+
+    set_emit_kind(pThis, EMIT_ARITHMETIC);
+    flush_inline_jump(pThis);
+
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "A=M-1\n");
+    OUT_LITERAL(pThis, "D=M\n");
+    out_at_local(pThis, "DIVABS", num);
+    OUT_LITERAL(pThis, "D;JGE\n");
+    OUT_LITERAL(pThis, "D=-D\n");
+    out_local_label(pThis, "DIVABS", num);
+    OUT_LITERAL(pThis, "@R13\n");
+    OUT_LITERAL(pThis, "M=D\n");            // R13 = |x|, 0x8000 for -32768
+
+    // M[SP] = R13 >> shift, one bit of R13 per iteration from bit shift up
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "A=M\n");
+    if (shift == 0) {
+        OUT_LITERAL(pThis, "M=D\n");
+    } else {
+        OUT_LITERAL(pThis, "M=0\n");
+        out_at_int(pThis, 1 << shift);
+        OUT_LITERAL(pThis, "D=A\n");
+        OUT_LITERAL(pThis, "@R14\n");
+        OUT_LITERAL(pThis, "M=D\n");        // R14 = bit of R13
+        OUT_LITERAL(pThis, "@R15\n");
+        OUT_LITERAL(pThis, "M=1\n");        // R15 = bit of the quotient
+        out_local_label(pThis, "DIVLOOP", num);
+        OUT_LITERAL(pThis, "@R14\n");
+        OUT_LITERAL(pThis, "D=M\n");
+        OUT_LITERAL(pThis, "@R13\n");
+        OUT_LITERAL(pThis, "D=D&M\n");
+        out_at_local(pThis, "DIVSKIP", num);
+        OUT_LITERAL(pThis, "D;JEQ\n");
+        OUT_LITERAL(pThis, "@R15\n");
+        OUT_LITERAL(pThis, "D=M\n");
+        OUT_LITERAL(pThis, "@SP\n");
+        OUT_LITERAL(pThis, "A=M\n");
+        OUT_LITERAL(pThis, "M=D+M\n");      // M[SP] += R15
+        out_local_label(pThis, "DIVSKIP", num);
+        OUT_LITERAL(pThis, "@R15\n");
+        OUT_LITERAL(pThis, "D=M\n");
+        OUT_LITERAL(pThis, "M=D+M\n");
+        OUT_LITERAL(pThis, "@R14\n");
+        OUT_LITERAL(pThis, "D=M\n");
+        OUT_LITERAL(pThis, "MD=D+M\n");     // becomes 0 after bit 15
+        out_at_local(pThis, "DIVLOOP", num);
+        OUT_LITERAL(pThis, "D;JNE\n");
+    }
+
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "A=M-1\n");
+    OUT_LITERAL(pThis, "D=M\n");
+    out_at_local(pThis, "DIVEND", num);
+    OUT_LITERAL(pThis, "D;JGE\n");          // x >= 0
+    if (shift & 1) {
+        OUT_LITERAL(pThis, "@32767\n");
+        OUT_LITERAL(pThis, "D=D+A\n");
+        OUT_LITERAL(pThis, "D=D+1\n");
+        out_at_local(pThis, "DIVEND", num);
+        OUT_LITERAL(pThis, "D;JEQ\n");      // x = -32768
+    }
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "A=M\n");
+    OUT_LITERAL(pThis, "M=-M\n");
+    OUT_LITERAL(pThis, "D=M\n");
+    OUT_LITERAL(pThis, "@1\n");
+    OUT_LITERAL(pThis, "D=D&A\n");
+    out_at_local(pThis, "DIVEND", num);
+    OUT_LITERAL(pThis, "D;JEQ\n");
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "A=M\n");
+    OUT_LITERAL(pThis, "M=M+1\n");
+    OUT_LITERAL(pThis, "M=M+1\n");          // odd: 2 too high
+    out_local_label(pThis, "DIVEND", num);
+    OUT_LITERAL(pThis, "@SP\n");
+    OUT_LITERAL(pThis, "A=M\n");
+    OUT_LITERAL(pThis, "D=M\n");
+    OUT_LITERAL(pThis, "A=A-1\n");
+    OUT_LITERAL(pThis, "M=D\n");            // M[SP - 1] = quotient
+
+    return;
+}
+
+static void out_at_local(CodeWriter *pThis, const char *name, int num)
+{
+    out_char(pThis, '@'); out_scope(pThis); out_str(pThis, name); out_char(pThis, '.'); out_int(pThis, num); out_char(pThis, '\n');
+
+    return;
+}
+
+static void out_local_label(CodeWriter *pThis, const char *name, int num)
+{
+    out_char(pThis, '('); out_scope(pThis); out_str(pThis, name); out_char(pThis, '.'); out_int(pThis, num); OUT_LITERAL(pThis, ")\n");
+
+    return;
+}
+
+// what is written from here on is counted as kind
+static void set_emit_kind(CodeWriter *pThis, enum emitKind kind)
+{
+    if (pThis->stats == NULL) return;
+
+    count_output(pThis);
+    pThis->emit_kind = kind;
+
+    return;
+}
+
+// every line since the mark that is not a label is one instruction
+static void count_output(CodeWriter *pThis)
+{
+    const char *p, *end;
+    long count = 0;
+
+    if (pThis->stats == NULL) return;
+
+    p   = pThis->out + pThis->stats_mark;
+    end = pThis->out + pThis->out_len;
+    while (p < end) {
+        if (*p != '(') count++;
+        p = memchr(p, '\n', end - p);
+        if (p == NULL) break;
+        p++;
+    }
 
-    fprintf(pThis->fp, "@%s.%d\n", pThis->filename, index);
-    fprintf(pThis->fp, "M=D\n");            // M[base + index] = D
+    pThis->stats->add(pThis->stats, label_scope(pThis), pThis->emit_kind, count);
+    pThis->stats_mark = pThis->out_len;
 
     return;
 }
@@ -6,49 +6,127 @@
 #define _CODE_WRITER_H_
 
 #include "command_type.h"
+#include "emit_stats.h"
 #include <stdio.h>
+#include <stdbool.h>
+
+// how the program is entered before the first function runs
+enum bootstrapMode {
+    BOOTSTRAP_CALL,             // SP = 256; call entry
+    BOOTSTRAP_JUMP,             // SP = LCL = ARG = 256; goto entry, which must not return
+    BOOTSTRAP_NONE,             // no code, the caller sets up SP
+};
+
+// push/pop/arithmetic held back while it may start a fused sequence
+#define FUSE_MAX_PENDING 3
+
+struct fuse_command {
+    enum commandType type;
+    enum segmentType segment;
+    int index;                  // segment index, or arithmetic operator
+};
+
+// state of a leaf function body being expanded at its call site
+struct inline_frame {
+    bool active;
+    int  num_args;
+    int  num_locals;
+    bool save_pointers;
+    bool pending_jump;
+    char *saved_funcname;
+    char *saved_filename;
+};
 
 typedef struct CodeWriter {
-    FILE *fp;
+    int  fd;
+    char *out;
+    size_t out_len;
+    size_t out_size;
+    int  ret_num;               // generated labels are numbered per function
+    int  cmp_num;
+    int  inline_num;
+    int  math_num;
     char *filename;
     char *funcname;
+    struct inline_frame inline_frame;
+    bool fuse;
+    bool lower_math;
+    struct fuse_command pending[FUSE_MAX_PENDING];
+    int  num_pending;
+    struct emit_stats *stats;   // counts instructions when set
+    enum emitKind emit_kind;
+    size_t stats_mark;          // output before this is counted
     void (*init)(struct CodeWriter*, char *);
+    void (*initBuffer)(struct CodeWriter *);
     void (*setFileName)(struct CodeWriter *, char *);
+    void (*setFusion)(struct CodeWriter *, bool);
+    void (*setMathLowering)(struct CodeWriter *, bool);
+    void (*setStatistics)(struct CodeWriter *, struct emit_stats *);
     void (*writeArithmetric)(struct CodeWriter *, char *);
-    void (*writePushPop)(struct CodeWriter *, enum commandType, char *, int);
+    void (*writePushPop)(struct CodeWriter *, enum commandType, enum segmentType, int);
     void (*writeLabel)(struct CodeWriter *, char *label);
     void (*writeGoto)(struct CodeWriter *, char *label);
     void (*writeIf)(struct CodeWriter *, char *label);
-    void (*writeInit)(struct CodeWriter *pThis);
+    void (*writeInit)(struct CodeWriter *pThis, enum bootstrapMode mode, char *entry);
     void (*writeCall)(struct CodeWriter *pThis, char *functionName, int numArgs);
     void (*writeReturn)(struct CodeWriter *pThis);
     void (*writeFunction)(struct CodeWriter *pThis, char *functionName, int numArgs);
+    void (*writeInlineBegin)(struct CodeWriter *pThis, char *functionName, char *filename, int numArgs, int numLocals, bool savePointers);
+    void (*writeInlineEnd)(struct CodeWriter *pThis);
+    void (*writeBuffer)(struct CodeWriter *pThis, struct CodeWriter *part);
+    void (*writeAssembly)(struct CodeWriter *pThis, const char *text, size_t len);
     void (*close)(struct CodeWriter *);
     void (*del)(struct CodeWriter *);
 } CodeWriter;
 
 
 extern void _code_writer_init(CodeWriter *pThis, char *filename);
+extern void _code_writer_initBuffer(CodeWriter *pThis);
 extern void _code_writer_setFileName(CodeWriter *pThis, char *filename);
+extern void _code_writer_setFusion(CodeWriter *pThis, bool fuse);
+extern void _code_writer_setMathLowering(CodeWriter *pThis, bool lower);
+extern void _code_writer_setStatistics(CodeWriter *pThis, struct emit_stats *stats);
 extern void _code_writer_writeArithmetric(CodeWriter *pThis, char *commnad);
-extern void _code_writer_writePushPop(CodeWriter *pThis, enum commandType command, char *segment, int index);
+extern void _code_writer_writePushPop(CodeWriter *pThis, enum commandType command, enum segmentType segment, int index);
 extern void _code_writer_writeLabel(CodeWriter *pThis, char *label);
 extern void _code_writer_writeGoto(CodeWriter *pThis, char *label);
 extern void _code_writer_writeIf(CodeWriter *pThis, char *label);
-extern void _code_writer_writeInit(CodeWriter *pThis);
+extern void _code_writer_writeInit(CodeWriter *pThis, enum bootstrapMode mode, char *entry);
 extern void _code_writer_writeCall(CodeWriter *pThis, char *functionName, int numArgs);
 extern void _code_writer_writeReturn(CodeWriter *pThis);
 extern void _code_writer_writeFunction(CodeWriter *pThis, char *functionName, int numArgs);
+extern void _code_writer_writeInlineBegin(CodeWriter *pThis, char *functionName, char *filename, int numArgs, int numLocals, bool savePointers);
+extern void _code_writer_writeInlineEnd(CodeWriter *pThis);
+extern void _code_writer_writeBuffer(CodeWriter *pThis, CodeWriter *part);
+extern void _code_writer_writeAssembly(CodeWriter *pThis, const char *text, size_t len);
 extern void _code_writer_close(CodeWriter *pThis);
 extern void _code_writer_del(CodeWriter *pThis);
 
 
 #define newCodeWriter() {                               \
-    .fp               = NULL,                           \
+    .fd               = -1,                             \
+    .out              = NULL,                           \
+    .out_len          = 0,                              \
+    .out_size         = 0,                              \
+    .ret_num          = 0,                              \
+    .cmp_num          = 0,                              \
+    .inline_num       = 0,                              \
+    .math_num         = 0,                              \
     .filename         = NULL,                           \
     .funcname         = NULL,                           \
+    .inline_frame     = {.active = false},              \
+    .fuse             = false,                          \
+    .lower_math       = false,                          \
+    .num_pending      = 0,                              \
+    .stats            = NULL,                           \
+    .emit_kind        = EMIT_CALL_RETURN,               \
+    .stats_mark       = 0,                              \
     .init             = _code_writer_init,              \
+    .initBuffer       = _code_writer_initBuffer,        \
     .setFileName      = _code_writer_setFileName,       \
+    .setFusion        = _code_writer_setFusion,         \
+    .setMathLowering  = _code_writer_setMathLowering,   \
+    .setStatistics    = _code_writer_setStatistics,     \
     .writeArithmetric = _code_writer_writeArithmetric,  \
     .writePushPop     = _code_writer_writePushPop,      \
     .writeLabel       = _code_writer_writeLabel,        \
@@ -58,6 +136,10 @@ extern void _code_writer_del(CodeWriter *pThis);
     .writeCall        = _code_writer_writeCall,         \
     .writeReturn      = _code_writer_writeReturn,       \
     .writeFunction    = _code_writer_writeFunction,     \
+    .writeInlineBegin = _code_writer_writeInlineBegin,  \
+    .writeInlineEnd   = _code_writer_writeInlineEnd,    \
+    .writeBuffer      = _code_writer_writeBuffer,       \
+    .writeAssembly    = _code_writer_writeAssembly,     \
     .close            = _code_writer_close,             \
     .del              = _code_writer_del,               \
 }
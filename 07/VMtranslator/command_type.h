@@ -18,4 +18,16 @@ enum commandType {
     C_OTHER,
 };
 
+enum segmentType {
+    S_CONSTANT,
+    S_LOCAL,
+    S_ARGUMENT,
+    S_THIS,
+    S_THAT,
+    S_POINTER,
+    S_TEMP,
+    S_STATIC,
+    S_OTHER,
+};
+
 #endif
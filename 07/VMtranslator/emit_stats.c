@@ -0,0 +1,124 @@
+/*
+ * emit_stats.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "emit_stats.h"
+
+#define FUNCTION_BLOCK_SIZE 256
+
+static const char *kind_names[NUM_EMIT_KINDS] = {
+    "push/pop", "arithmetic", "branch", "call/return", "fused",
+};
+
+static int compare_total(const void *a, const void *b);
+
+void _emit_stats_init(EmitStats *pThis)
+{
+    pThis->functions = (struct function_stats *)malloc(sizeof(struct function_stats) * FUNCTION_BLOCK_SIZE);
+    pThis->num_functions = 0;
+
+    return;
+}
+
+void _emit_stats_add(EmitStats *pThis, const char *function, enum emitKind kind, long count)
+{
+    struct function_stats *f;
+
+    if (count == 0) return;
+
+    f = pThis->num_functions ? &pThis->functions[pThis->num_functions - 1] : NULL;
+    if (f == NULL || strcmp(f->name, function)) {
+        if (pThis->num_functions != 0 && pThis->num_functions % FUNCTION_BLOCK_SIZE == 0) {
+            pThis->functions = (struct function_stats *)realloc(pThis->functions,
+                                sizeof(struct function_stats) * (pThis->num_functions + FUNCTION_BLOCK_SIZE));
+        }
+        f = &pThis->functions[pThis->num_functions++];
+        memset(f, 0, sizeof(struct function_stats));
+        f->name = (char *)malloc(sizeof(char) * strlen(function) + 1);
+        strcpy(f->name, function);
+    }
+
+    f->count[kind] += count;
+    f->total += count;
+
+    return;
+}
+
+void _emit_stats_merge(EmitStats *pThis, EmitStats *part)
+{
+    int i, kind;
+
+    for (i = 0; i < part->num_functions; i++)
+        for (kind = 0; kind < NUM_EMIT_KINDS; kind++)
+            _emit_stats_add(pThis, part->functions[i].name, kind, part->functions[i].count[kind]);
+
+    return;
+}
+
+void _emit_stats_report(EmitStats *pThis, FILE *fp, int top)
+{
+    struct function_stats **sorted;
+    long total[NUM_EMIT_KINDS] = {0}, sum = 0;
+    int i, kind;
+
+    for (i = 0; i < pThis->num_functions; i++) {
+        for (kind = 0; kind < NUM_EMIT_KINDS; kind++)
+            total[kind] += pThis->functions[i].count[kind];
+        sum += pThis->functions[i].total;
+    }
+
+    fprintf(fp, "stats: %ld instructions in %d function(s)\n", sum, pThis->num_functions);
+    for (kind = 0; kind < NUM_EMIT_KINDS; kind++)
+        fprintf(fp, "stats: %-12s %8ld %5.1f%%\n", kind_names[kind], total[kind],
+                sum ? 100.0 * total[kind] / sum : 0.0);
+
+    sorted = (struct function_stats **)malloc(sizeof(struct function_stats *) * (pThis->num_functions + 1));
+    for (i = 0; i < pThis->num_functions; i++)
+        sorted[i] = &pThis->functions[i];
+    qsort(sorted, pThis->num_functions, sizeof(struct function_stats *), compare_total);
+
+    if (top > pThis->num_functions) top = pThis->num_functions;
+    fprintf(fp, "stats: %-32s %8s", "function", "total");
+    for (kind = 0; kind < NUM_EMIT_KINDS; kind++)
+        fprintf(fp, " %11s", kind_names[kind]);
+    fprintf(fp, "\n");
+    for (i = 0; i < top; i++) {
+        fprintf(fp, "stats: %-32s %8ld", sorted[i]->name, sorted[i]->total);
+        for (kind = 0; kind < NUM_EMIT_KINDS; kind++)
+            fprintf(fp, " %11ld", sorted[i]->count[kind]);
+        fprintf(fp, "\n");
+    }
+
+    free(sorted);
+
+    return;
+}
+
+void _emit_stats_del(EmitStats *pThis)
+{
+    int i;
+
+    for (i = 0; i < pThis->num_functions; i++)
+        free(pThis->functions[i].name);
+    free(pThis->functions);
+    pThis->functions = NULL;
+    pThis->num_functions = 0;
+
+    return;
+}
+
+// largest first, ties in name order so the report is stable
+static int compare_total(const void *a, const void *b)
+{
+    const struct function_stats *x = *(const struct function_stats **)a;
+    const struct function_stats *y = *(const struct function_stats **)b;
+
+    if (x->total != y->total)
+        return x->total < y->total ? 1 : -1;
+
+    return strcmp(x->name, y->name);
+}
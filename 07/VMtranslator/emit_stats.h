@@ -0,0 +1,55 @@
+/*
+ * emit_stats.h
+ */
+
+#ifndef _EMIT_STATS_H_
+#define _EMIT_STATS_H_
+
+#include <stdio.h>
+
+// what the assembly was written for
+enum emitKind {
+    EMIT_PUSH_POP,
+    EMIT_ARITHMETIC,
+    EMIT_BRANCH,
+    EMIT_CALL_RETURN,           // call, return, function entry, bootstrap
+    EMIT_FUSED,                 // superinstructions
+    NUM_EMIT_KINDS
+};
+
+struct function_stats {
+    char *name;
+    long count[NUM_EMIT_KINDS];
+    long total;
+};
+
+// instructions (ROM words) emitted per function and kind; a function's
+// counts are contiguous, so a new name starts a new entry
+typedef struct emit_stats {
+    struct function_stats *functions;
+    int num_functions;
+
+    void (*init)(struct emit_stats *);
+    void (*add)(struct emit_stats *, const char *, enum emitKind, long);
+    void (*merge)(struct emit_stats *, struct emit_stats *);
+    void (*report)(struct emit_stats *, FILE *, int);
+    void (*del)(struct emit_stats *);
+} EmitStats;
+
+extern void _emit_stats_init(EmitStats *pThis);
+extern void _emit_stats_add(EmitStats *pThis, const char *function, enum emitKind kind, long count);
+extern void _emit_stats_merge(EmitStats *pThis, EmitStats *part);
+extern void _emit_stats_report(EmitStats *pThis, FILE *fp, int top);
+extern void _emit_stats_del(EmitStats *pThis);
+
+#define newEmitStats() {                    \
+    .functions     = NULL,                  \
+    .num_functions = 0,                     \
+    .init          = _emit_stats_init,      \
+    .add           = _emit_stats_add,       \
+    .merge         = _emit_stats_merge,     \
+    .report        = _emit_stats_report,    \
+    .del           = _emit_stats_del,       \
+}
+
+#endif
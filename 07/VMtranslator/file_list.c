@@ -0,0 +1,148 @@
+/*
+ * file_list.c
+ */
+
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+
+#include "file_list.h"
+
+#define FILE_BLOCK_SIZE 64
+
+static bool has_extension(FileList *pThis, const char *name);
+static void add_file(FileList *pThis, const char *dir, const char *name);
+static int  compare_filename(const void *a, const void *b);
+
+void _file_list_init(FileList *pThis, const char *extension)
+{
+    pThis->filenames = NULL;
+    pThis->num_files = 0;
+    pThis->extension = (char *)malloc(sizeof(char) * strlen(extension) + 1);
+    strcpy(pThis->extension, extension);
+
+    return;
+}
+
+// a file is taken if it has the extension; a directory is read once and
+// its matching entries are added in sorted order
+void _file_list_add(FileList *pThis, char *path)
+{
+    struct stat s;
+    DIR *dirp;
+    struct dirent *dp;
+    int first = pThis->num_files;
+
+    if (stat(path, &s) == -1) {
+        fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
+        exit errno;
+    }
+
+    if (!S_ISDIR(s.st_mode)) {
+        if (has_extension(pThis, path))
+            add_file(pThis, NULL, path);
+        return;
+    }
+
+    dirp = opendir(path);
+    if (dirp == NULL) {
+        fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
+        exit errno;
+    }
+
+    while ((dp = readdir(dirp)) != NULL) {
+        if (has_extension(pThis, dp->d_name))
+            add_file(pThis, path, dp->d_name);
+    }
+    closedir(dirp);
+
+    qsort(&pThis->filenames[first], pThis->num_files - first, sizeof(struct filename), compare_filename);
+
+    return;
+}
+
+// the basename of a source names its class and statics, so two sources
+// with one basename cannot go into the same program
+bool _file_list_checkNames(FileList *pThis)
+{
+    int i, j;
+
+    for (i = 0; i < pThis->num_files; i++) {
+        for (j = 0; j < i; j++) {
+            if (!strcmp(pThis->filenames[i].basename, pThis->filenames[j].basename)) {
+                printf("Error: %s and %s are both named %s\n", pThis->filenames[j].fullname,
+                       pThis->filenames[i].fullname, pThis->filenames[i].basename);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void _file_list_del(FileList *pThis)
+{
+    int i;
+
+    for (i = 0; i < pThis->num_files; i++) {
+        free(pThis->filenames[i].extension);
+        free(pThis->filenames[i].basename);
+        free(pThis->filenames[i].fullname);
+    }
+
+    free(pThis->filenames);
+    free(pThis->extension);
+    pThis->filenames = NULL;
+    pThis->extension = NULL;
+    pThis->num_files = 0;
+
+    return;
+}
+
+static bool has_extension(FileList *pThis, const char *name)
+{
+    const char *dot = strrchr(name, '.');
+
+    return dot != NULL && dot != name && !strcmp(dot + 1, pThis->extension);
+}
+
+static void add_file(FileList *pThis, const char *dir, const char *name)
+{
+    struct filename *file;
+    const char *base, *dot;
+
+    if (pThis->num_files % FILE_BLOCK_SIZE == 0) {
+        pThis->filenames = (struct filename *)realloc(pThis->filenames,
+                            sizeof(struct filename) * (pThis->num_files + FILE_BLOCK_SIZE));
+    }
+    file = &pThis->filenames[pThis->num_files++];
+
+    if (dir == NULL) {
+        file->fullname = (char *)malloc(sizeof(char) * strlen(name) + 1);
+        strcpy(file->fullname, name);
+    } else {
+        file->fullname = (char *)malloc(sizeof(char) * (strlen(dir) + strlen(name) + 2));
+        sprintf(file->fullname, "%s/%s", dir, name);
+    }
+
+    base = strrchr(name, '/');
+    base = base == NULL ? name : base + 1;
+    dot  = strrchr(base, '.');
+
+    file->basename = (char *)malloc(sizeof(char) * (dot - base) + 1);
+    memcpy(file->basename, base, dot - base);
+    file->basename[dot - base] = '\0';
+
+    file->extension = (char *)malloc(sizeof(char) * strlen(dot + 1) + 1);
+    strcpy(file->extension, dot + 1);
+
+    return;
+}
+
+static int compare_filename(const void *a, const void *b)
+{
+    return strcmp(((const struct filename *)a)->fullname, ((const struct filename *)b)->fullname);
+}
@@ -0,0 +1,44 @@
+/*
+ * file_list.h
+ */
+
+#ifndef _FILE_LIST_H_
+#define _FILE_LIST_H_
+
+#include <stdbool.h>
+
+struct filename {
+    char *fullname;
+    char *basename;
+    char *extension;
+};
+
+// the source files of one run, in command line order; the files of a
+// directory are sorted by name so the order never depends on readdir
+typedef struct file_list {
+    struct filename *filenames;
+    int  num_files;
+    char *extension;
+
+    void (*init)(struct file_list *, const char *);
+    void (*add)(struct file_list *, char *);
+    bool (*checkNames)(struct file_list *);
+    void (*del)(struct file_list *);
+} FileList;
+
+extern void _file_list_init(FileList *pThis, const char *extension);
+extern void _file_list_add(FileList *pThis, char *path);
+extern bool _file_list_checkNames(FileList *pThis);
+extern void _file_list_del(FileList *pThis);
+
+#define newFileList() {                     \
+    .filenames  = NULL,                     \
+    .num_files  = 0,                        \
+    .extension  = NULL,                     \
+    .init       = _file_list_init,          \
+    .add        = _file_list_add,           \
+    .checkNames = _file_list_checkNames,    \
+    .del        = _file_list_del,           \
+}
+
+#endif
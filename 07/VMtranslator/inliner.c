@@ -0,0 +1,328 @@
+/*
+ * inliner.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "inliner.h"
+
+#define FUNCTION_BLOCK_SIZE     256
+#define COMMAND_BLOCK_SIZE      16
+
+// size heuristics, in VM commands (function header excluded)
+#define INLINE_MAX_COMMANDS     12  // copied into every call site
+#define INLINE_MAX_SINGLE_CALL  64  // copied into the only call site
+
+static struct inline_function *search_function(Inliner *pThis, char *name);
+static struct inline_function *add_function(Inliner *pThis, char *name);
+static bool has_label(struct inline_function *function, char *label);
+static int saved_cycles(struct inline_function *function);
+static long count_instructions(EmitStats *stats);
+
+void _inliner_init(Inliner *pThis)
+{
+    pThis->functions = (struct inline_function *)malloc(sizeof(struct inline_function) * FUNCTION_BLOCK_SIZE);
+    pThis->num_functions = 0;
+    pThis->current = -1;
+    pthread_mutex_init(&pThis->lock, NULL);
+
+    return;
+}
+
+void _inliner_addCommand(Inliner *pThis, char *filename, enum commandType type, enum segmentType segment, char *arg1, int arg2)
+{
+    struct inline_function *function, *callee;
+    struct vm_command *command;
+
+    if (type == C_FUNCTION) {
+        function = search_function(pThis, arg1);
+        if (function == NULL) function = add_function(pThis, arg1);
+
+        // which of two bodies a call reaches is up to the assembler, so
+        // neither is expanded
+        if (function->defined) {
+            function->redefined = true;
+            pThis->current = -1;
+            return;
+        }
+
+        function->filename = (char *)malloc(sizeof(char) * strlen(filename) + 1);
+        strcpy(function->filename, filename);
+        function->num_locals = arg2;
+        function->defined = true;
+
+        pThis->current = function - pThis->functions;
+        return;
+    }
+
+    if (type == C_CALL) {
+        callee = search_function(pThis, arg1);
+        if (callee == NULL) callee = add_function(pThis, arg1);
+
+        callee->num_calls++;
+        callee->num_args = arg2;
+    }
+
+    // commands outside of any function are never inlined
+    if (pThis->current < 0) return;
+    function = &pThis->functions[pThis->current];
+
+    if (strcmp(function->filename, filename)) {
+        pThis->current = -1;
+        return;
+    }
+
+    switch (type) {
+        case C_CALL:
+            function->leaf = false;
+            break;
+        case C_GOTO:
+        case C_IF:
+            if (has_label(function, arg1))
+                function->has_loop = true;
+            break;
+        case C_POP:
+            if (segment == S_POINTER)
+                function->sets_pointer = true;
+            break;
+        default:
+            break;
+    }
+
+    if (function->num_commands < INLINE_MAX_SINGLE_CALL) {
+        if (function->num_commands % COMMAND_BLOCK_SIZE == 0) {
+            function->commands = (struct vm_command *)realloc(function->commands,
+                                    sizeof(struct vm_command) * (function->num_commands + COMMAND_BLOCK_SIZE));
+        }
+
+        command = &function->commands[function->num_commands];
+        command->type = type;
+        command->segment = segment;
+        command->arg2 = arg2;
+        command->arg1 = NULL;
+        if (arg1 != NULL) {
+            command->arg1 = (char *)malloc(sizeof(char) * strlen(arg1) + 1);
+            strcpy(command->arg1, arg1);
+        }
+    }
+
+    function->num_commands++;
+
+    return;
+}
+
+bool _inliner_canInline(Inliner *pThis, char *name)
+{
+    struct inline_function *function;
+
+    function = search_function(pThis, name);
+
+    if (function == NULL || !function->defined || function->redefined) return false;
+    if (!function->leaf || function->has_loop) return false;
+
+    if (function->num_commands <= INLINE_MAX_COMMANDS)
+        return true;
+
+    if (function->num_calls == 1 && function->num_commands <= INLINE_MAX_SINGLE_CALL)
+        return true;
+
+    return false;
+}
+
+void _inliner_expand(Inliner *pThis, CodeWriter *writer, char *name, int numArgs)
+{
+    struct inline_function *function;
+    struct vm_command *command;
+    int i;
+
+    function = search_function(pThis, name);
+
+    writer->writeInlineBegin(writer, function->name, function->filename,
+                             numArgs, function->num_locals, function->sets_pointer);
+
+    for (i = 0; i < function->num_commands; i++) {
+        command = &function->commands[i];
+
+        switch (command->type) {
+            case C_ARITHMETRIC:
+                writer->writeArithmetric(writer, command->arg1);
+                break;
+            case C_PUSH:
+            case C_POP:
+                writer->writePushPop(writer, command->type, command->segment, command->arg2);
+                break;
+            case C_LABEL:
+                writer->writeLabel(writer, command->arg1);
+                break;
+            case C_GOTO:
+                writer->writeGoto(writer, command->arg1);
+                break;
+            case C_IF:
+                writer->writeIf(writer, command->arg1);
+                break;
+            case C_RETURN:
+                writer->writeReturn(writer);
+                break;
+            default:
+                break;
+        }
+    }
+
+    writer->writeInlineEnd(writer);
+
+    // call sites may be expanded from several translation threads
+    pthread_mutex_lock(&pThis->lock);
+    function->num_expanded++;
+    pthread_mutex_unlock(&pThis->lock);
+
+    return;
+}
+
+// a call site expanded by an earlier run, whose code comes from the cache
+void _inliner_countExpansion(Inliner *pThis, char *name)
+{
+    struct inline_function *function;
+
+    function = search_function(pThis, name);
+    if (function == NULL) return;
+
+    pthread_mutex_lock(&pThis->lock);
+    function->num_expanded++;
+    pthread_mutex_unlock(&pThis->lock);
+
+    return;
+}
+
+void _inliner_report(Inliner *pThis, FILE *fp)
+{
+    struct inline_function *function;
+    int i, saved, sites = 0, total = 0;
+
+    for (i = 0; i < pThis->num_functions; i++) {
+        function = &pThis->functions[i];
+        if (function->num_expanded == 0) continue;
+
+        saved = saved_cycles(function);
+
+        fprintf(fp, "inline: %-32s %4d call site(s) %4d cycles saved per call\n",
+                function->name, function->num_expanded, saved);
+
+        sites += function->num_expanded;
+        total += saved * function->num_expanded;
+    }
+
+    fprintf(fp, "inline: %d call site(s), %d cycles saved when each runs once\n", sites, total);
+
+    return;
+}
+
+void _inliner_del(Inliner *pThis)
+{
+    int i, j;
+
+    for (i = 0; i < pThis->num_functions; i++) {
+        for (j = 0; j < pThis->functions[i].num_commands && j < INLINE_MAX_SINGLE_CALL; j++)
+            free(pThis->functions[i].commands[j].arg1);
+        free(pThis->functions[i].commands);
+        free(pThis->functions[i].filename);
+        free(pThis->functions[i].name);
+    }
+
+    free(pThis->functions);
+    pThis->functions = NULL;
+    pThis->num_functions = 0;
+    pThis->current = -1;
+    pthread_mutex_destroy(&pThis->lock);
+
+    return;
+}
+
+static struct inline_function *search_function(Inliner *pThis, char *name)
+{
+    int i;
+
+    for (i = 0; i < pThis->num_functions; i++)
+        if (!strcmp(pThis->functions[i].name, name))
+            return &pThis->functions[i];
+
+    return NULL;
+}
+
+static struct inline_function *add_function(Inliner *pThis, char *name)
+{
+    struct inline_function *function;
+
+    if (pThis->num_functions != 0 && pThis->num_functions % FUNCTION_BLOCK_SIZE == 0) {
+        pThis->functions = (struct inline_function *)realloc(pThis->functions,
+                                sizeof(struct inline_function) * (pThis->num_functions + FUNCTION_BLOCK_SIZE));
+    }
+
+    function = &pThis->functions[pThis->num_functions];
+    memset(function, 0, sizeof(struct inline_function));
+    function->name = (char *)malloc(sizeof(char) * strlen(name) + 1);
+    strcpy(function->name, name);
+    function->leaf = true;
+
+    pThis->num_functions++;
+
+    return function;
+}
+
+static bool has_label(struct inline_function *function, char *label)
+{
+    int i;
+
+    for (i = 0; i < function->num_commands && i < INLINE_MAX_SINGLE_CALL; i++)
+        if (function->commands[i].type == C_LABEL && !strcmp(function->commands[i].arg1, label))
+            return true;
+
+    return false;
+}
+
+// the call and return sequences less the inline entry and exit, written by
+// a scratch writer and counted; all of them are straight line code, so an
+// instruction is a cycle
+static int saved_cycles(struct inline_function *function)
+{
+    CodeWriter writer = newCodeWriter();
+    EmitStats stats = newEmitStats();
+    long called, inlined;
+
+    writer.initBuffer(&writer);
+    writer.setFileName(&writer, function->filename);
+
+    stats.init(&stats);
+    writer.setStatistics(&writer, &stats);
+    writer.writeCall(&writer, function->name, function->num_args);
+    writer.writeReturn(&writer);
+    writer.setStatistics(&writer, NULL);
+    called = count_instructions(&stats);
+    stats.del(&stats);
+
+    stats.init(&stats);
+    writer.setStatistics(&writer, &stats);
+    writer.writeInlineBegin(&writer, function->name, function->filename,
+                            function->num_args, 0, function->sets_pointer);
+    writer.writeReturn(&writer);
+    writer.writeInlineEnd(&writer);
+    writer.setStatistics(&writer, NULL);
+    inlined = count_instructions(&stats);
+    stats.del(&stats);
+
+    writer.del(&writer);
+
+    return called - inlined;
+}
+
+static long count_instructions(EmitStats *stats)
+{
+    long total = 0;
+    int i;
+
+    for (i = 0; i < stats->num_functions; i++)
+        total += stats->functions[i].total;
+
+    return total;
+}
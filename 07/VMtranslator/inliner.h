@@ -0,0 +1,73 @@
+/*
+ * inliner.h
+ */
+
+#ifndef _INLINER_H_
+#define _INLINER_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "command_type.h"
+#include "code_writer.h"
+
+struct vm_command {
+    enum commandType type;
+    enum segmentType segment;
+    char *arg1;
+    int  arg2;
+};
+
+struct inline_function {
+    char *name;
+    char *filename;
+    int  num_locals;
+    struct vm_command *commands;
+    int  num_commands;
+    int  num_calls;
+    int  num_expanded;
+    int  num_args;
+    bool defined;
+    bool redefined;             // defined in more than one place
+    bool leaf;
+    bool has_loop;
+    bool sets_pointer;
+};
+
+typedef struct inliner {
+    struct inline_function *functions;
+    int num_functions;
+    int current;
+    pthread_mutex_t lock;
+
+    void (*init)(struct inliner *);
+    void (*addCommand)(struct inliner *, char *, enum commandType, enum segmentType, char *, int);
+    bool (*canInline)(struct inliner *, char *);
+    void (*expand)(struct inliner *, CodeWriter *, char *, int);
+    void (*countExpansion)(struct inliner *, char *);
+    void (*report)(struct inliner *, FILE *);
+    void (*del)(struct inliner *);
+} Inliner;
+
+extern void _inliner_init(Inliner *pThis);
+extern void _inliner_addCommand(Inliner *pThis, char *filename, enum commandType type, enum segmentType segment, char *arg1, int arg2);
+extern bool _inliner_canInline(Inliner *pThis, char *name);
+extern void _inliner_expand(Inliner *pThis, CodeWriter *writer, char *name, int numArgs);
+extern void _inliner_countExpansion(Inliner *pThis, char *name);
+extern void _inliner_report(Inliner *pThis, FILE *fp);
+extern void _inliner_del(Inliner *pThis);
+
+#define newInliner() {                          \
+    .functions      = NULL,                     \
+    .num_functions  = 0,                        \
+    .current        = -1,                       \
+    .init           = _inliner_init,            \
+    .addCommand     = _inliner_addCommand,      \
+    .canInline      = _inliner_canInline,       \
+    .expand         = _inliner_expand,          \
+    .countExpansion = _inliner_countExpansion,  \
+    .report         = _inliner_report,          \
+    .del            = _inliner_del,             \
+}
+
+#endif
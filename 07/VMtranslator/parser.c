@@ -7,281 +7,281 @@
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "parser.h"
 
-#define BUFF_BLOCK_SIZE 1024
-#define LINE_BLOCK_SIZE 1024
-#define SIZE_OF_ARRAY(a) ((sizeof(a)) / (sizeof(a[0])))
+#define RECORD_BLOCK_SIZE 256
 
-static void trimStartSpaces(char *str);
-static void trimEndSpaces(char *str);
-static void uniteBlanks(char *str);
-static void trimComments(char *str);
+#define IS_BLANK(c) ((c) == ' ' || (c) == '\t')
+#define IS_EOL(c)   ((c) == '\n' || (c) == '\r')
 
-static bool hasCommandsInList(char *command, const char **list, size_t size);
+static void skipBlankLines(Parser *pThis);
+static char *scanToken(Parser *pThis, size_t end, char *dst);
+static bool isComment(Parser *pThis, size_t pos);
+
+static enum commandType classifyCommand(const char *command);
+static enum segmentType classifySegment(const char *segment);
+static void initRecord(Parser *pThis);
 
 void _parser_init(Parser *pThis, char *name)
 {
-    FILE *fp;
-    char *buff;
-    int ch;
-    int indx = 0;
-    int line_num = 0;
-    int buff_block_num = 1;
-    int line_block_num = 1;
+    struct stat st;
+    int fd;
 
-    fp = fopen(name, "r");
+    fd = open(name, O_RDONLY);
 
-    if (fp == NULL) {
+    if (fd == -1 || fstat(fd, &st) == -1) {
         perror("Error");
         exit errno;
     }
 
-    pThis->lines        = NULL;
-    pThis->current_arg1 = NULL;
-    pThis->current_line = -1;
-
-    buff = (char *)malloc(sizeof(unsigned char) * BUFF_BLOCK_SIZE * buff_block_num);
-    pThis->lines = (char **)malloc(sizeof(char *)
-                                    * LINE_BLOCK_SIZE * line_block_num);
-
-    while ((ch = fgetc(fp)) != EOF) {
-        if (ch == '\n' || ch == '\r') {
-            buff[indx] = '\0';
-
-            trimComments(buff);
-            trimStartSpaces(buff);
-            trimEndSpaces(buff);
-            uniteBlanks(buff);
-
-            if (strlen(buff) != 0) {
-                pThis->lines[line_num]
-                    = (char *)malloc(sizeof(unsigned char) * strlen(buff) + 1);
-                strncpy(pThis->lines[line_num], buff, strlen(buff) + 1);
-
-                line_num++;
-                if (line_num == LINE_BLOCK_SIZE * line_block_num) {
-                    line_block_num++;
-                    pThis->lines
-                        = (char **)realloc(pThis->lines,
-                            sizeof(char *)
-                            * LINE_BLOCK_SIZE * line_block_num);
-                }
-            }
-            indx = 0;
-            continue;
-        }
+    pThis->data = NULL;
+    pThis->size = st.st_size;
+    pThis->pos  = 0;
 
-        buff[indx++] = (unsigned char)ch;
-
-        if (indx == BUFF_BLOCK_SIZE * buff_block_num) {
-            buff_block_num++;
-            buff = (char *)realloc(buff,
-                                    sizeof(ch) * BUFF_BLOCK_SIZE * buff_block_num);
+    // the file is never copied; commands are read straight from the mapping
+    if (pThis->size != 0) {
+        pThis->data = (char *)mmap(NULL, pThis->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (pThis->data == MAP_FAILED) {
+            perror("Error");
+            exit errno;
         }
     }
+    close(fd);
+    pThis->mapped = pThis->data != NULL;
 
-    pThis->lines[line_num] = NULL;
+    initRecord(pThis);
+}
 
-    free(buff);
-    fclose(fp);
+// commands already in memory, such as a compiler's output; the buffer is
+// read in place and must outlive the parser
+void _parser_initBuffer(Parser *pThis, char *data, size_t size)
+{
+    pThis->data   = data;
+    pThis->size   = size;
+    pThis->pos    = 0;
+    pThis->mapped = false;
+
+    initRecord(pThis);
 }
 
 bool _parser_hasMoreCommands(Parser *pThis)
 {
-    return pThis->lines[pThis->current_line + 1] == NULL ? false : true;
+    skipBlankLines(pThis);
+
+    return pThis->pos < pThis->size ? true : false;
 }
 
 void _parser_advance(Parser *pThis)
 {
-    pThis->current_line++;
+    size_t end;
+    char *arg2;
+
+    skipBlankLines(pThis);
+
+    // the command ends at the line end or at a comment
+    for (end = pThis->pos; end < pThis->size; end++)
+        if (IS_EOL(pThis->data[end]) || isComment(pThis, end)) break;
+
+    // "command arg1 arg2" never needs more than the line plus terminators
+    if (end - pThis->pos + 3 > pThis->record_size) {
+        while (end - pThis->pos + 3 > pThis->record_size)
+            pThis->record_size += RECORD_BLOCK_SIZE;
+        pThis->record = (char *)realloc(pThis->record, sizeof(char) * pThis->record_size);
+    }
+
+    pThis->current_arg1 = scanToken(pThis, end, pThis->record);
+    arg2 = scanToken(pThis, end, pThis->current_arg1);
+    scanToken(pThis, end, arg2);
+    pThis->current_arg2 = atoi(arg2);
+
+    pThis->current_type = classifyCommand(pThis->record);
+    pThis->current_segment = S_OTHER;
+    if (pThis->current_type == C_PUSH || pThis->current_type == C_POP)
+        pThis->current_segment = classifySegment(pThis->current_arg1);
+
+    // whatever is left of the line is a comment
+    while (pThis->pos < pThis->size && !IS_EOL(pThis->data[pThis->pos]))
+        pThis->pos++;
 }
 
 void _parser_reset(Parser *pThis)
 {
-    pThis->current_line = -1;
+    pThis->pos = 0;
 }
 
 enum commandType _parser_commandType(Parser *pThis)
 {
-    char *current_command = pThis->lines[pThis->current_line];
-    static const char *list_arithmetric[] = {
-        "add", "sub", "neg", "eq", "gt",
-        "lt",  "and", "or",  "not",
-    };
-    static const char *list_pop[] = {"pop"};
-    static const char *list_push[] = {"push"};
-    static const char *list_label[] = {"label"};
-    static const char *list_goto[] = {"goto"};
-    static const char *list_if_goto[] = {"if-goto"};
-    static const char *list_function[] = {"function"};
-    static const char *list_return[] = {"return"};
-    static const char *list_call[] = {"call"};
-
-    if (hasCommandsInList(current_command, list_arithmetric, SIZE_OF_ARRAY(list_arithmetric)))
-        return C_ARITHMETRIC;
-    else if (hasCommandsInList(current_command, list_pop, SIZE_OF_ARRAY(list_pop)))
-        return C_POP;
-    else if (hasCommandsInList(current_command, list_push, SIZE_OF_ARRAY(list_pop)))
-        return C_PUSH;
-    else if (hasCommandsInList(current_command, list_label, SIZE_OF_ARRAY(list_label)))
-        return C_LABEL;
-    else if (hasCommandsInList(current_command, list_goto, SIZE_OF_ARRAY(list_goto)))
-        return C_GOTO;
-    else if (hasCommandsInList(current_command, list_if_goto, SIZE_OF_ARRAY(list_if_goto)))
-        return C_IF;
-    else if (hasCommandsInList(current_command, list_function, SIZE_OF_ARRAY(list_function)))
-        return C_FUNCTION;
-    else if (hasCommandsInList(current_command, list_return, SIZE_OF_ARRAY(list_return)))
-        return C_RETURN;
-    else if (hasCommandsInList(current_command, list_call, SIZE_OF_ARRAY(list_call)))
-        return C_CALL;
-    else
-        return C_OTHER;
+    return pThis->current_type;
 }
 
-char *_parser_arg1(Parser *pThis)
+enum segmentType _parser_segment(Parser *pThis)
 {
-    const char *current_command = pThis->lines[pThis->current_line];
-    char *buf, *arg1;
-    char *space;
-
-    buf = (char *)malloc(sizeof(char) * strlen(current_command) + 1);
-    strcpy(buf, current_command);
-
-    // get arg1 position and strings
-    if (pThis->commandType(pThis) == C_ARITHMETRIC) {
-        arg1 = buf;
-    } else {
-        if ((arg1 = strchr(buf, ' ')) ==  NULL)
-            return NULL;
-
-        arg1 += 1;
+    return pThis->current_segment;
+}
 
-        // if there is space after arg1
-        if ((space = strchr(arg1, ' ')) != NULL) *space = '\0';
-    }
+char *_parser_arg1(Parser *pThis)
+{
+    // arithmetic commands are their own argument
+    if (pThis->commandType(pThis) == C_ARITHMETRIC)
+        return pThis->record;
 
-    pThis->current_arg1 = (char *)malloc(sizeof(char) * strlen(arg1) + 1);
-    strcpy(pThis->current_arg1, arg1);
+    if (*pThis->current_arg1 == '\0')
+        return NULL;
 
-    free(buf);
     return pThis->current_arg1;
 }
 
 int _parser_arg2(Parser *pThis)
 {
-    char *current_command = pThis->lines[pThis->current_line];
-    char *index;
-
-    index = strrchr(current_command, ' ');
-
-    if (index == NULL) return 0;
-
-    return atoi(index + 1);
+    return pThis->current_arg2;
 }
 
 void _parser_delete(Parser *pThis)
 {
-    int i;
-
-    for (i = 0; pThis->lines[i] != NULL; i++) {
-        free(pThis->lines[i]);
-        pThis->lines[i] = NULL;
-    }
-
-    free(pThis->lines);
-    pThis->lines = NULL;
-    free(pThis->current_arg1);
+    if (pThis->mapped)
+        munmap(pThis->data, pThis->size);
+
+    pThis->data = NULL;
+    pThis->mapped = false;
+    pThis->size = 0;
+    pThis->pos  = 0;
+    free(pThis->record);
+    pThis->record = NULL;
+    pThis->record_size = 0;
     pThis->current_arg1 = NULL;
-    pThis->current_line = -1;
+    pThis->current_arg2 = 0;
 }
 
 
-static bool hasCommandsInList(char *command, const char **list, size_t size)
+static void initRecord(Parser *pThis)
 {
-    size_t i;
-    char *buf = (char *)malloc(sizeof(char) * strlen(command) + 1);;
-    bool ret = false;
-
-    strcpy(buf, command);
-    for (i = 0; buf[i] != '\0'; i++) {
-        if (buf[i] == ' ') {
-            buf[i] = '\0';
-            break;
-        }
-    }
+    pThis->record_size  = RECORD_BLOCK_SIZE;
+    pThis->record       = (char *)malloc(sizeof(char) * pThis->record_size);
+    pThis->record[0]    = '\0';
+    pThis->current_type    = C_OTHER;
+    pThis->current_segment = S_OTHER;
+    pThis->current_arg1    = pThis->record;
+    pThis->current_arg2    = 0;
+}
 
-    for (i = 0; i < size; i++) {
-        if (!strcmp(buf, list[i])) {
-            ret = true;
+// the first character leaves at most two commands to compare
+static enum commandType classifyCommand(const char *command)
+{
+    switch (command[0]) {
+        case 'a':
+            if (!strcmp(command, "add") || !strcmp(command, "and")) return C_ARITHMETRIC;
+            break;
+        case 'c':
+            if (!strcmp(command, "call")) return C_CALL;
+            break;
+        case 'e':
+            if (!strcmp(command, "eq")) return C_ARITHMETRIC;
+            break;
+        case 'f':
+            if (!strcmp(command, "function")) return C_FUNCTION;
+            break;
+        case 'g':
+            if (!strcmp(command, "gt")) return C_ARITHMETRIC;
+            if (!strcmp(command, "goto")) return C_GOTO;
+            break;
+        case 'i':
+            if (!strcmp(command, "if-goto")) return C_IF;
+            break;
+        case 'l':
+            if (!strcmp(command, "lt")) return C_ARITHMETRIC;
+            if (!strcmp(command, "label")) return C_LABEL;
+            break;
+        case 'n':
+            if (!strcmp(command, "neg") || !strcmp(command, "not")) return C_ARITHMETRIC;
+            break;
+        case 'o':
+            if (!strcmp(command, "or")) return C_ARITHMETRIC;
+            break;
+        case 'p':
+            if (!strcmp(command, "push")) return C_PUSH;
+            if (!strcmp(command, "pop")) return C_POP;
+            break;
+        case 'r':
+            if (!strcmp(command, "return")) return C_RETURN;
+            break;
+        case 's':
+            if (!strcmp(command, "sub")) return C_ARITHMETRIC;
+            break;
+        default:
             break;
-        }
     }
 
-    free(buf);
-    return ret;
+    return C_OTHER;
 }
 
-static void trimStartSpaces(char *str)
+// and at most three segments ('t' is this, that or temp)
+static enum segmentType classifySegment(const char *segment)
 {
-    char *buf;
-    char *orig = str;
-
-    if (str == NULL || str[0] != ' ') return;
-
-    buf = (char *)malloc(sizeof(char) * strlen(str) + 1);
-
-    while (*str == ' ') str++;
-
-    strcpy(buf, str);
-    strcpy(orig, buf);
+    switch (segment[0]) {
+        case 'a':
+            if (!strcmp(segment, "argument")) return S_ARGUMENT;
+            break;
+        case 'c':
+            if (!strcmp(segment, "constant")) return S_CONSTANT;
+            break;
+        case 'l':
+            if (!strcmp(segment, "local")) return S_LOCAL;
+            break;
+        case 'p':
+            if (!strcmp(segment, "pointer")) return S_POINTER;
+            break;
+        case 's':
+            if (!strcmp(segment, "static")) return S_STATIC;
+            break;
+        case 't':
+            if (!strcmp(segment, "this")) return S_THIS;
+            if (!strcmp(segment, "that")) return S_THAT;
+            if (!strcmp(segment, "temp")) return S_TEMP;
+            break;
+        default:
+            break;
+    }
 
-    free(buf);
-    return;
+    return S_OTHER;
 }
 
-static void trimEndSpaces(char *str)
+static void skipBlankLines(Parser *pThis)
 {
-    int i;
-
-    for (i = strlen(str); i != 0; i--) {
-        if (str[i - 1] != ' ') {
-            str[i] = '\0';
-            return;
+    while (pThis->pos < pThis->size) {
+        if (IS_BLANK(pThis->data[pThis->pos]) || IS_EOL(pThis->data[pThis->pos])) {
+            pThis->pos++;
+        } else if (isComment(pThis, pThis->pos)) {
+            while (pThis->pos < pThis->size && !IS_EOL(pThis->data[pThis->pos]))
+                pThis->pos++;
+        } else {
+            break;
         }
     }
 
-    str[0] = '\0';
     return;
 }
 
-static void uniteBlanks(char *str)
+// copy the next blank separated token before end to dst, NUL terminated,
+// and return where the following token should be copied
+static char *scanToken(Parser *pThis, size_t end, char *dst)
 {
-    char *buf = (char *)malloc(sizeof(char) * strlen(str) + 1);
-    char *orig = str;
-    char *orig_buf = buf;
+    while (pThis->pos < end && IS_BLANK(pThis->data[pThis->pos]))
+        pThis->pos++;
 
-    while ((*buf++ = *str++) != '\0') {
-        if (*(str - 1) == ' ')
-            while (*str == ' ') str++;
-    }
+    while (pThis->pos < end && !IS_BLANK(pThis->data[pThis->pos]))
+        *dst++ = pThis->data[pThis->pos++];
 
-    strcpy(orig, orig_buf);
-    free(orig_buf);
+    *dst++ = '\0';
 
-    return;
+    return dst;
 }
 
-static void trimComments(char *str)
+static bool isComment(Parser *pThis, size_t pos)
 {
-    while (*str != '\0') {
-        if (*(str - 1) == '/' && *str == '/') {
-            *(str - 1) = '\0';
-            return;
-        }
-        str++;
-    }
-    return ;
+    return pThis->data[pos] == '/' && pos + 1 < pThis->size && pThis->data[pos + 1] == '/';
 }
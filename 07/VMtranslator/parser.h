@@ -6,41 +6,62 @@
 #define _PARSER_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "command_type.h"
 
 typedef struct parser {
-    char **lines;
-    int  current_line;
-    char *current_arg1;
+    char   *data;           // mapped source file, or the caller's buffer
+    size_t size;
+    bool   mapped;
+    size_t pos;
+    char   *record;         // current command: "command\0arg1\0"
+    size_t record_size;
+    enum commandType current_type;
+    enum segmentType current_segment;
+    char   *current_arg1;
+    int    current_arg2;
 
     void (*init)(struct parser *, char *);
+    void (*initBuffer)(struct parser *, char *, size_t);
     bool (*hasMoreCommands)(struct parser *);
     void (*advance)(struct parser *);
     void (*reset)(struct parser *);
     enum commandType (*commandType)(struct parser *);
+    enum segmentType (*segment)(struct parser *);
     char *(*arg1)(struct parser *);
     int  (*arg2)(struct parser *);
     void (*del)(struct parser *);
 } Parser;
 
 extern void _parser_init(Parser *pThis, char *name);
+extern void _parser_initBuffer(Parser *pThis, char *data, size_t size);
 extern bool _parser_hasMoreCommands(Parser *pThis);
 extern void _parser_advance(Parser *pThis);
 extern void _parser_reset(Parser *pThis);
 extern enum commandType  _parser_commandType(Parser *pThis);
+extern enum segmentType  _parser_segment(Parser *pThis);
 extern char *_parser_arg1(Parser *pThis);
 extern int  _parser_arg2(Parser *pThis);
 extern void _parser_delete(Parser *pThis);
 
 #define newParser() {       \
-    .lines = NULL,          \
-    .current_line = -1,     \
+    .data = NULL,           \
+    .size = 0,              \
+    .mapped = false,        \
+    .pos = 0,               \
+    .record = NULL,         \
+    .record_size = 0,       \
+    .current_type = C_OTHER,        \
+    .current_segment = S_OTHER,     \
     .current_arg1 = NULL,   \
+    .current_arg2 = 0,      \
     .init = _parser_init,   \
+    .initBuffer = _parser_initBuffer,           \
     .hasMoreCommands = _parser_hasMoreCommands, \
     .advance = _parser_advance,                 \
     .reset = _parser_reset,                     \
     .commandType = _parser_commandType,         \
+    .segment = _parser_segment,                 \
     .arg1 = _parser_arg1,                       \
     .arg2 = _parser_arg2,                       \
     .del = _parser_delete,                      \
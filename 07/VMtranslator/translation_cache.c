@@ -0,0 +1,168 @@
+/*
+ * translation_cache.c
+ */
+
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "translation_cache.h"
+
+#define FNV_PRIME 1099511628211ULL
+
+static char *entry_path(TranslationCache *pThis, uint64_t key, const char *suffix);
+static char *read_entry(TranslationCache *pThis, uint64_t key, const char *suffix, size_t *len);
+static void write_entry(TranslationCache *pThis, uint64_t key, const char *suffix, char *data, size_t len);
+
+uint64_t hashBytes(uint64_t hash, const void *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+void _translation_cache_init(TranslationCache *pThis, char *dir)
+{
+    if (mkdir(dir, 0755) == -1 && errno != EEXIST) {
+        fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
+        exit errno;
+    }
+
+    pThis->dir = (char *)malloc(sizeof(char) * strlen(dir) + 1);
+    strcpy(pThis->dir, dir);
+
+    return;
+}
+
+// a missing or unreadable entry is a miss, the file is simply translated
+bool _translation_cache_load(TranslationCache *pThis, uint64_t key, CodeWriter *writer)
+{
+    char *buf;
+    size_t len;
+
+    buf = read_entry(pThis, key, ".asm", &len);
+    if (buf == NULL) return false;
+
+    writer->writeAssembly(writer, buf, len);
+    free(buf);
+
+    return true;
+}
+
+void _translation_cache_store(TranslationCache *pThis, uint64_t key, CodeWriter *writer)
+{
+    write_entry(pThis, key, ".asm", writer->out, writer->out_len);
+
+    return;
+}
+
+// the functions inlined into a fragment, one line per call site, so a
+// cached file still shows up in the inline report; NULL if there is none
+char *_translation_cache_loadInlined(TranslationCache *pThis, uint64_t key, size_t *len)
+{
+    return read_entry(pThis, key, ".inline", len);
+}
+
+void _translation_cache_storeInlined(TranslationCache *pThis, uint64_t key, char *data, size_t len)
+{
+    write_entry(pThis, key, ".inline", data, len);
+
+    return;
+}
+
+void _translation_cache_del(TranslationCache *pThis)
+{
+    free(pThis->dir);
+    pThis->dir = NULL;
+
+    return;
+}
+
+static char *entry_path(TranslationCache *pThis, uint64_t key, const char *suffix)
+{
+    char *path;
+
+    path = (char *)malloc(sizeof(char) * (strlen(pThis->dir) + strlen(suffix) + 18));
+    sprintf(path, "%s/%016llx%s", pThis->dir, (unsigned long long)key, suffix);
+
+    return path;
+}
+
+// the whole entry, NUL terminated, or NULL if it cannot be read
+static char *read_entry(TranslationCache *pThis, uint64_t key, const char *suffix, size_t *len)
+{
+    struct stat s;
+    char *path, *buf;
+    ssize_t n;
+    int fd;
+
+    path = entry_path(pThis, key, suffix);
+    fd = open(path, O_RDONLY);
+    free(path);
+    if (fd == -1) return NULL;
+
+    if (fstat(fd, &s) == -1) {
+        close(fd);
+        return NULL;
+    }
+
+    buf = (char *)malloc(sizeof(char) * s.st_size + 1);
+    *len = 0;
+    while (*len < (size_t)s.st_size && (n = read(fd, buf + *len, s.st_size - *len)) > 0)
+        *len += n;
+    close(fd);
+
+    if (*len != (size_t)s.st_size) {
+        free(buf);
+        return NULL;
+    }
+    buf[*len] = '\0';
+
+    return buf;
+}
+
+// entries are written under a temporary name and renamed into place, so a
+// reader never sees half of one
+static void write_entry(TranslationCache *pThis, uint64_t key, const char *suffix, char *data, size_t len)
+{
+    char *tmp, *path, tmp_suffix[40];
+    size_t done = 0;
+    ssize_t n;
+    int fd;
+
+    sprintf(tmp_suffix, "%s.%ld.tmp", suffix, (long)getpid());
+    tmp  = entry_path(pThis, key, tmp_suffix);
+    path = entry_path(pThis, key, suffix);
+
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
+        free(tmp);
+        free(path);
+        return;
+    }
+
+    while (done < len && (n = write(fd, data + done, len - done)) > 0)
+        done += n;
+    close(fd);
+
+    if (done != len || rename(tmp, path) == -1) {
+        fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
+        unlink(tmp);
+    }
+
+    free(tmp);
+    free(path);
+
+    return;
+}
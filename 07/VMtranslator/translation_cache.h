@@ -0,0 +1,48 @@
+/*
+ * translation_cache.h
+ */
+
+#ifndef _TRANSLATION_CACHE_H_
+#define _TRANSLATION_CACHE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "code_writer.h"
+
+// 64 bit FNV-1a; keys are built by hashing every input of a translation
+#define HASH_INIT 14695981039346656037ULL
+
+extern uint64_t hashBytes(uint64_t hash, const void *data, size_t len);
+
+// assembly of translated files, one <key>.asm per fragment, and with
+// inlining the functions expanded into it in <key>.inline
+typedef struct translation_cache {
+    char *dir;
+
+    void (*init)(struct translation_cache *, char *);
+    bool (*load)(struct translation_cache *, uint64_t, CodeWriter *);
+    void (*store)(struct translation_cache *, uint64_t, CodeWriter *);
+    char *(*loadInlined)(struct translation_cache *, uint64_t, size_t *);
+    void (*storeInlined)(struct translation_cache *, uint64_t, char *, size_t);
+    void (*del)(struct translation_cache *);
+} TranslationCache;
+
+extern void _translation_cache_init(TranslationCache *pThis, char *dir);
+extern bool _translation_cache_load(TranslationCache *pThis, uint64_t key, CodeWriter *writer);
+extern void _translation_cache_store(TranslationCache *pThis, uint64_t key, CodeWriter *writer);
+extern char *_translation_cache_loadInlined(TranslationCache *pThis, uint64_t key, size_t *len);
+extern void _translation_cache_storeInlined(TranslationCache *pThis, uint64_t key, char *data, size_t len);
+extern void _translation_cache_del(TranslationCache *pThis);
+
+#define newTranslationCache() {                         \
+    .dir          = NULL,                               \
+    .init         = _translation_cache_init,            \
+    .load         = _translation_cache_load,            \
+    .store        = _translation_cache_store,           \
+    .loadInlined  = _translation_cache_loadInlined,     \
+    .storeInlined = _translation_cache_storeInlined,    \
+    .del          = _translation_cache_del,             \
+}
+
+#endif
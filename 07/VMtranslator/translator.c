@@ -0,0 +1,485 @@
+/*
+ * translator.c
+ */
+
+#include <stdbool.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "translator.h"
+#include "parser.h"
+
+// part of every cache key; change it whenever the generated assembly changes
+#define CACHE_VERSION "VMtranslator 2"
+
+static void addUnit(Translator *pThis, char *name, char *path, char *data, size_t size);
+static void openUnit(struct translation_unit *unit, Parser *parser);
+static void buildCallGraph(Translator *pThis);
+static void *translateWorker(void *arg);
+static void translateFile(Translator *pThis, struct translation_unit *unit);
+static bool loadCached(Translator *pThis, struct translation_unit *unit, uint64_t key);
+static void addInlined(struct translation_unit *unit, char *name);
+static uint64_t hashInlineBodies(Inliner *inliner);
+static uint64_t hashCallee(Inliner *inliner, uint64_t hash, char *name);
+static uint64_t hashInlineBody(uint64_t hash, struct inline_function *f);
+static uint64_t unitKey(Translator *pThis, struct translation_unit *unit);
+
+void _translator_init(Translator *pThis)
+{
+    pThis->units = NULL;
+    pThis->num_units = 0;
+    pThis->next = 0;
+    pThis->num_cached = 0;
+    pThis->call_graph.init(&pThis->call_graph);
+    pThis->inliner.init(&pThis->inliner);
+    pthread_mutex_init(&pThis->lock, NULL);
+}
+
+// a .vm file, read when it is translated
+void _translator_addFile(Translator *pThis, char *name, char *path)
+{
+    addUnit(pThis, name, path, NULL, 0);
+}
+
+// commands that are already in memory; data must outlive the translation
+void _translator_addSource(Translator *pThis, char *name, char *data, size_t size)
+{
+    addUnit(pThis, name, NULL, data, size);
+}
+
+// the whole program after the bootstrap of code_writer, in the order the
+// sources were added; code_writer is left open for the caller to close.
+// false if the entry function is not defined, with nothing written
+bool _translator_translate(Translator *pThis, CodeWriter *code_writer,
+                           enum bootstrapMode bootstrap, char *entry)
+{
+    CallGraph *call_graph = &pThis->call_graph;
+    Inliner *inliner = &pThis->inliner;
+    struct translation_unit *unit;
+    pthread_t *threads;
+    int i, num_threads;
+
+    // the call graph knows every function, so a bootstrap into one that is
+    // not defined is refused before anything is written
+    buildCallGraph(pThis);
+    if (bootstrap != BOOTSTRAP_NONE && !call_graph->contains(call_graph, entry)) {
+        fprintf(stderr, "Error: entry function %s is not defined (use -b none for a program without one)\n", entry);
+        return false;
+    }
+
+    code_writer->setStatistics(code_writer, pThis->stats);
+    code_writer->writeInit(code_writer, bootstrap, entry);
+    code_writer->setStatistics(code_writer, NULL);
+
+    // small leaf functions are expanded at their call sites
+    if (pThis->inline_calls) {
+        for (i = 0; i < call_graph->num_nodes; i++)
+            if (inliner->canInline(inliner, call_graph->nodes[i].name))
+                call_graph->markInlined(call_graph, call_graph->nodes[i].name);
+    }
+
+    // drop functions that cannot be reached from the entry point; without
+    // a bootstrap the program starts at its first command, which need not
+    // be in any function, so everything is kept
+    pThis->prune = bootstrap != BOOTSTRAP_NONE;
+    if (pThis->prune)
+        call_graph->markReachable(call_graph, entry);
+
+    if (pThis->cache != NULL)
+        pThis->inline_hash = pThis->inline_calls ? hashInlineBodies(inliner) : 0;
+
+    // translate every source into its own buffer, several at a time
+    pThis->next = 0;
+    num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_threads > pThis->num_units) num_threads = pThis->num_units;
+    if (num_threads < 1) num_threads = 1;
+
+    threads = (pthread_t *)malloc(sizeof(pthread_t) * num_threads);
+    for (i = 0; i < num_threads; i++) {
+        errno = pthread_create(&threads[i], NULL, translateWorker, pThis);
+        if (errno != 0) {
+            fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
+            exit errno;
+        }
+    }
+    for (i = 0; i < num_threads; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+
+    // concatenate in the order added so the output does not depend on scheduling
+    pThis->num_cached = 0;
+    for (i = 0; i < pThis->num_units; i++) {
+        unit = &pThis->units[i];
+        code_writer->writeBuffer(code_writer, &unit->code_writer);
+        unit->code_writer.del(&unit->code_writer);
+        if (unit->cached) pThis->num_cached++;
+        if (pThis->stats != NULL) {
+            pThis->stats->merge(pThis->stats, &unit->stats);
+            unit->stats.del(&unit->stats);
+        }
+    }
+
+    return true;
+}
+
+void _translator_del(Translator *pThis)
+{
+    int i;
+
+    for (i = 0; i < pThis->num_units; i++) {
+        free(pThis->units[i].name);
+        free(pThis->units[i].path);
+    }
+    free(pThis->units);
+    pThis->units = NULL;
+    pThis->num_units = 0;
+
+    pthread_mutex_destroy(&pThis->lock);
+    pThis->call_graph.del(&pThis->call_graph);
+    pThis->inliner.del(&pThis->inliner);
+}
+
+static void addUnit(Translator *pThis, char *name, char *path, char *data, size_t size)
+{
+    struct translation_unit *unit;
+
+    pThis->units = (struct translation_unit *)realloc(pThis->units,
+                        sizeof(struct translation_unit) * (pThis->num_units + 1));
+    if (pThis->units == NULL) {
+        fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
+        exit errno;
+    }
+
+    unit = &pThis->units[pThis->num_units++];
+    unit->name = (char *)malloc(sizeof(char) * strlen(name) + 1);
+    strcpy(unit->name, name);
+    unit->path = NULL;
+    if (path != NULL) {
+        unit->path = (char *)malloc(sizeof(char) * strlen(path) + 1);
+        strcpy(unit->path, path);
+    }
+    unit->data = data;
+    unit->size = size;
+    unit->code_writer = (CodeWriter)newCodeWriter();
+    unit->cached = false;
+    unit->inlined = NULL;
+    unit->inlined_len = 0;
+    unit->stats = (EmitStats)newEmitStats();
+    unit->hash = 0;
+    unit->first_function = 0;
+    unit->last_function = 0;
+    unit->stray_calls = false;
+}
+
+static void openUnit(struct translation_unit *unit, Parser *parser)
+{
+    if (unit->path != NULL)
+        parser->init(parser, unit->path);
+    else
+        parser->initBuffer(parser, unit->data, unit->size);
+}
+
+static void buildCallGraph(Translator *pThis)
+{
+    Parser parser = newParser();
+    CallGraph *graph = &pThis->call_graph;
+    Inliner *inliner = &pThis->inliner;
+    struct translation_unit *unit;
+    char *function = NULL;
+    enum commandType type;
+    int i;
+
+    for (i = 0; i < pThis->num_units; i++) {
+        unit = &pThis->units[i];
+        openUnit(unit, &parser);
+        unit->hash = hashBytes(HASH_INIT, parser.data, parser.size);
+        unit->first_function = graph->num_nodes;
+
+        while (parser.hasMoreCommands(&parser)) {
+            parser.advance(&parser);
+
+            type = parser.commandType(&parser);
+            inliner->addCommand(inliner, unit->name, type, parser.segment(&parser),
+                                type == C_RETURN ? NULL : parser.arg1(&parser), parser.arg2(&parser));
+
+            switch (type) {
+                case C_FUNCTION:
+                    free(function);
+                    function = (char *)malloc(sizeof(char) * strlen(parser.arg1(&parser)) + 1);
+                    strcpy(function, parser.arg1(&parser));
+                    // the calls of a second body go to the node of the first
+                    if (graph->contains(graph, function))
+                        unit->stray_calls = true;
+                    graph->addFunction(graph, function);
+                    break;
+                case C_CALL:
+                    if (function != NULL)
+                        graph->addCall(graph, function, parser.arg1(&parser));
+                    else
+                        unit->stray_calls = true;
+                    break;
+                default:
+                    break;
+            }
+        }
+        unit->last_function = graph->num_nodes;
+        parser.del(&parser);
+        free(function);
+        function = NULL;
+    }
+
+    return;
+}
+
+static void *translateWorker(void *arg)
+{
+    Translator *pThis = (Translator *)arg;
+    int index;
+
+    for (;;) {
+        pthread_mutex_lock(&pThis->lock);
+        index = pThis->next++;
+        pthread_mutex_unlock(&pThis->lock);
+
+        if (index >= pThis->num_units) break;
+
+        translateFile(pThis, &pThis->units[index]);
+    }
+
+    return NULL;
+}
+
+static void translateFile(Translator *pThis, struct translation_unit *unit)
+{
+    Parser parser = newParser();
+    CodeWriter *code_writer = &unit->code_writer;
+    CallGraph *call_graph = &pThis->call_graph;
+    Inliner *inliner = &pThis->inliner;
+    bool emit = true;
+    uint64_t key = 0;
+
+    code_writer->initBuffer(code_writer);
+    code_writer->setFileName(code_writer, unit->name);
+    code_writer->setFusion(code_writer, pThis->fuse);
+    code_writer->setMathLowering(code_writer, pThis->lower_math);
+
+    // counting needs the commands, so a cached file is translated again
+    if (pThis->stats != NULL) {
+        unit->stats.init(&unit->stats);
+        code_writer->setStatistics(code_writer, &unit->stats);
+    }
+
+    if (pThis->cache != NULL) {
+        key = unitKey(pThis, unit);
+        if (pThis->stats == NULL && loadCached(pThis, unit, key)) {
+            unit->cached = true;
+            return;
+        }
+    }
+
+    openUnit(unit, &parser);
+
+    while (parser.hasMoreCommands(&parser)) {
+        parser.advance(&parser);
+
+        if (pThis->prune && parser.commandType(&parser) == C_FUNCTION)
+            emit = call_graph->isReachable(call_graph, parser.arg1(&parser));
+        if (!emit) continue;
+
+        switch(parser.commandType(&parser)) {
+            case C_ARITHMETRIC:
+                code_writer->writeArithmetric(code_writer, parser.arg1(&parser));
+                break;
+            case C_PUSH:
+                code_writer->writePushPop(code_writer, C_PUSH, parser.segment(&parser), parser.arg2(&parser));
+                break;
+            case C_POP:
+                code_writer->writePushPop(code_writer, C_POP, parser.segment(&parser), parser.arg2(&parser));
+                break;
+            case C_LABEL:
+                code_writer->writeLabel(code_writer, parser.arg1(&parser));
+                break;
+            case C_GOTO:
+                code_writer->writeGoto(code_writer, parser.arg1(&parser));
+                break;
+            case C_IF:
+                code_writer->writeIf(code_writer, parser.arg1(&parser));
+                break;
+            case C_FUNCTION:
+                code_writer->writeFunction(code_writer, parser.arg1(&parser), parser.arg2(&parser));
+                break;
+            case C_RETURN:
+                code_writer->writeReturn(code_writer);
+                break;
+            case C_CALL:
+                if (pThis->inline_calls && inliner->canInline(inliner, parser.arg1(&parser))) {
+                    inliner->expand(inliner, code_writer, parser.arg1(&parser), parser.arg2(&parser));
+                    addInlined(unit, parser.arg1(&parser));
+                } else
+                    code_writer->writeCall(code_writer, parser.arg1(&parser), parser.arg2(&parser));
+                break;
+            default:
+                break;
+        }
+    }
+    // writes out whatever the writer still holds back for fusion
+    code_writer->close(code_writer);
+    parser.del(&parser);
+
+    // the list of inlined functions goes in first, so an entry whose
+    // assembly can be read always has it
+    if (pThis->cache != NULL) {
+        if (pThis->inline_calls)
+            pThis->cache->storeInlined(pThis->cache, key, unit->inlined, unit->inlined_len);
+        pThis->cache->store(pThis->cache, key, code_writer);
+    }
+    free(unit->inlined);
+    unit->inlined = NULL;
+    unit->inlined_len = 0;
+
+    return;
+}
+
+// a cached file counts the call sites inlined into it for the report
+static bool loadCached(Translator *pThis, struct translation_unit *unit, uint64_t key)
+{
+    char *inlined = NULL, *name, *end;
+    size_t len;
+
+    if (pThis->inline_calls) {
+        inlined = pThis->cache->loadInlined(pThis->cache, key, &len);
+        if (inlined == NULL) return false;
+    }
+
+    if (!pThis->cache->load(pThis->cache, key, &unit->code_writer)) {
+        free(inlined);
+        return false;
+    }
+
+    for (name = inlined; name != NULL && *name != '\0'; name = end + 1) {
+        end = strchr(name, '\n');
+        if (end == NULL) break;
+        *end = '\0';
+        pThis->inliner.countExpansion(&pThis->inliner, name);
+    }
+    free(inlined);
+
+    return true;
+}
+
+static void addInlined(struct translation_unit *unit, char *name)
+{
+    size_t len = strlen(name);
+
+    unit->inlined = (char *)realloc(unit->inlined, sizeof(char) * (unit->inlined_len + len + 1));
+    if (unit->inlined == NULL) {
+        fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
+        exit errno;
+    }
+    memcpy(unit->inlined + unit->inlined_len, name, len);
+    unit->inlined[unit->inlined_len + len] = '\n';
+    unit->inlined_len += len + 1;
+}
+
+// every body that may be expanded at a call site, for the files whose calls
+// the call graph does not hold
+static uint64_t hashInlineBodies(Inliner *inliner)
+{
+    struct inline_function *f;
+    uint64_t hash = HASH_INIT;
+    int i;
+
+    for (i = 0; i < inliner->num_functions; i++) {
+        f = &inliner->functions[i];
+        if (inliner->canInline(inliner, f->name))
+            hash = hashInlineBody(hash, f);
+    }
+
+    return hash;
+}
+
+// whether a call is expanded, and into what
+static uint64_t hashCallee(Inliner *inliner, uint64_t hash, char *name)
+{
+    bool inlined;
+    int i;
+
+    inlined = inliner->canInline(inliner, name);
+    hash = hashBytes(hash, name, strlen(name) + 1);
+    hash = hashBytes(hash, &inlined, sizeof(inlined));
+    if (!inlined) return hash;
+
+    for (i = 0; i < inliner->num_functions; i++)
+        if (!strcmp(inliner->functions[i].name, name))
+            return hashInlineBody(hash, &inliner->functions[i]);
+
+    return hash;
+}
+
+// one body, with its statics' file
+static uint64_t hashInlineBody(uint64_t hash, struct inline_function *f)
+{
+    struct vm_command *c;
+    int j;
+
+    hash = hashBytes(hash, f->name, strlen(f->name) + 1);
+    hash = hashBytes(hash, f->filename, strlen(f->filename) + 1);
+    hash = hashBytes(hash, &f->num_locals, sizeof(f->num_locals));
+    hash = hashBytes(hash, &f->num_args, sizeof(f->num_args));
+    for (j = 0; j < f->num_commands; j++) {
+        c = &f->commands[j];
+        hash = hashBytes(hash, &c->type, sizeof(c->type));
+        hash = hashBytes(hash, &c->segment, sizeof(c->segment));
+        hash = hashBytes(hash, &c->arg2, sizeof(c->arg2));
+        if (c->arg1 != NULL)
+            hash = hashBytes(hash, c->arg1, strlen(c->arg1) + 1);
+    }
+
+    return hash;
+}
+
+// everything the assembly of one file depends on: its name and contents,
+// the options, which of its functions survive pruning and the bodies that
+// may be inlined into it
+static uint64_t unitKey(Translator *pThis, struct translation_unit *unit)
+{
+    struct call_graph_node *node;
+    uint64_t hash = HASH_INIT;
+    bool flags[4], reachable;
+    int i, j;
+
+    flags[0] = pThis->prune;
+    flags[1] = pThis->inline_calls;
+    flags[2] = pThis->fuse;
+    flags[3] = pThis->lower_math;
+
+    hash = hashBytes(hash, CACHE_VERSION, sizeof(CACHE_VERSION));
+    hash = hashBytes(hash, flags, sizeof(flags));
+    hash = hashBytes(hash, unit->name, strlen(unit->name) + 1);
+    hash = hashBytes(hash, &unit->hash, sizeof(unit->hash));
+
+    if (pThis->prune) {
+        for (i = unit->first_function; i < unit->last_function; i++) {
+            reachable = pThis->call_graph.nodes[i].reachable;
+            hash = hashBytes(hash, &reachable, sizeof(reachable));
+        }
+    }
+
+    // only the functions this file calls, so a change to one body leaves
+    // the files that never call it cached; a file with calls the graph
+    // does not hold for it depends on every body
+    if (pThis->inline_calls && unit->stray_calls) {
+        hash = hashBytes(hash, &pThis->inline_hash, sizeof(pThis->inline_hash));
+    } else if (pThis->inline_calls) {
+        for (i = unit->first_function; i < unit->last_function; i++) {
+            node = &pThis->call_graph.nodes[i];
+            for (j = 0; j < node->num_callees; j++)
+                hash = hashCallee(&pThis->inliner, hash, node->callees[j]);
+        }
+    }
+
+    return hash;
+}
@@ -0,0 +1,89 @@
+/*
+ * translator.h
+ */
+
+#ifndef _TRANSLATOR_H_
+#define _TRANSLATOR_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "code_writer.h"
+#include "call_graph.h"
+#include "inliner.h"
+#include "translation_cache.h"
+#include "emit_stats.h"
+
+// one .vm source translated into its own in-memory writer
+struct translation_unit {
+    char *name;                 // basename, which names the file's statics
+    char *path;                 // the file to read, or NULL for data
+    char *data;                 // commands already in memory
+    size_t size;
+    CodeWriter code_writer;
+    bool cached;
+    char *inlined;              // the functions inlined, a line per call site
+    size_t inlined_len;
+    EmitStats stats;
+    uint64_t hash;              // of the contents, set by buildCallGraph
+    int  first_function;        // call graph nodes defined in this file
+    int  last_function;
+    bool stray_calls;           // calls outside them, or in a second body
+};
+
+// the .vm sources of one program, translated several at a time and joined
+// in the order they were added; while translating, only next is written,
+// under lock
+typedef struct translator {
+    struct translation_unit *units;
+    int num_units;
+    int next;
+    pthread_mutex_t lock;
+    CallGraph call_graph;
+    Inliner inliner;
+    bool prune;
+    bool inline_calls;
+    bool fuse;
+    bool lower_math;
+    EmitStats *stats;           // counts of the whole program, or NULL
+    TranslationCache *cache;    // or NULL
+    uint64_t inline_hash;
+    int num_cached;
+
+    void (*init)(struct translator *);
+    void (*addFile)(struct translator *, char *, char *);
+    void (*addSource)(struct translator *, char *, char *, size_t);
+    bool (*translate)(struct translator *, CodeWriter *, enum bootstrapMode, char *);
+    void (*del)(struct translator *);
+} Translator;
+
+extern void _translator_init(Translator *pThis);
+extern void _translator_addFile(Translator *pThis, char *name, char *path);
+extern void _translator_addSource(Translator *pThis, char *name, char *data, size_t size);
+extern bool _translator_translate(Translator *pThis, CodeWriter *code_writer,
+                                  enum bootstrapMode bootstrap, char *entry);
+extern void _translator_del(Translator *pThis);
+
+#define newTranslator() {                       \
+    .units        = NULL,                       \
+    .num_units    = 0,                          \
+    .next         = 0,                          \
+    .call_graph   = newCallGraph(),             \
+    .inliner      = newInliner(),               \
+    .prune        = false,                      \
+    .inline_calls = false,                      \
+    .fuse         = false,                      \
+    .lower_math   = false,                      \
+    .stats        = NULL,                       \
+    .cache        = NULL,                       \
+    .inline_hash  = 0,                          \
+    .num_cached   = 0,                          \
+    .init         = _translator_init,           \
+    .addFile      = _translator_addFile,        \
+    .addSource    = _translator_addSource,      \
+    .translate    = _translator_translate,      \
+    .del          = _translator_del,            \
+}
+
+#endif
@@ -0,0 +1,688 @@
+/*
+ * vm_machine.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser.h"
+#include "vm_machine.h"
+#include "vm_native.h"
+
+#define CODE_BLOCK_SIZE     4096
+#define FILE_BLOCK_SIZE     64
+#define SYMBOL_BLOCK_SIZE   1024
+
+#define ENTRY_FUNCTION      "Sys.init"
+#define HALT_FUNCTION       "Sys.halt"
+
+// code[0] calls the entry function and code[1] stops when it returns
+#define BOOTSTRAP_SIZE      2
+
+static void add_instruction(VMMachine *pThis, int op, int num, int arg);
+static bool add_symbol(VMMachine *pThis, char *name, int target);
+static int  search_symbol(VMMachine *pThis, char *name);
+static unsigned long hash_symbol(const char *name);
+static char *scoped_label(char *function, char *label);
+static char *class_name(const char *path);
+static int  arithmetic_opcode(char *command);
+static int  fused_opcode(const struct vm_instruction *in, int *length);
+
+void _vm_machine_init(VMMachine *pThis)
+{
+    pThis->ram = (int16_t *)calloc(VM_RAM_SIZE, sizeof(int16_t));
+    pThis->code = NULL;
+    pThis->num_code = 0;
+    pThis->size_symbols = SYMBOL_BLOCK_SIZE;
+    pThis->symbols = (struct vm_symbol *)calloc(pThis->size_symbols, sizeof(struct vm_symbol));
+    pThis->num_symbols = 0;
+    pThis->files = NULL;
+    pThis->num_files = 0;
+    pThis->num_statics = 0;
+    pThis->entry = BOOTSTRAP_SIZE;
+
+    return;
+}
+
+void _vm_machine_addFile(VMMachine *pThis, char *path)
+{
+    if (pThis->num_files % FILE_BLOCK_SIZE == 0) {
+        pThis->files = (char **)realloc(pThis->files,
+                            sizeof(char *) * (pThis->num_files + FILE_BLOCK_SIZE));
+    }
+
+    pThis->files[pThis->num_files] = (char *)malloc(sizeof(char) * strlen(path) + 1);
+    strcpy(pThis->files[pThis->num_files], path);
+    pThis->num_files++;
+
+    return;
+}
+
+bool _vm_machine_link(VMMachine *pThis)
+{
+    Parser parser = newParser();
+    enum commandType type;
+    int *static_base;
+    char *function, *name;
+    int i, index, target, count, statics, native;
+    bool ok = true;
+
+    static_base = (int *)malloc(sizeof(int) * (pThis->num_files + 1));
+
+    // first pass: where every function and label starts, and static sizes
+    count = BOOTSTRAP_SIZE;
+    for (i = 0; i < pThis->num_files; i++) {
+        parser.init(&parser, pThis->files[i]);
+        function = NULL;
+        statics = 0;
+
+        while (parser.hasMoreCommands(&parser)) {
+            parser.advance(&parser);
+            type = parser.commandType(&parser);
+
+            switch (type) {
+                case C_FUNCTION:
+                    free(function);
+                    function = (char *)malloc(sizeof(char) * strlen(parser.arg1(&parser)) + 1);
+                    strcpy(function, parser.arg1(&parser));
+                    if (!add_symbol(pThis, function, count)) {
+                        fprintf(stderr, "Error: function %s is defined twice\n", function);
+                        ok = false;
+                    }
+                    count++;
+                    break;
+                case C_LABEL:
+                    name = scoped_label(function, parser.arg1(&parser));
+                    add_symbol(pThis, name, count);
+                    free(name);
+                    break;
+                case C_PUSH:
+                case C_POP:
+                    if (parser.segment(&parser) == S_STATIC && parser.arg2(&parser) >= statics)
+                        statics = parser.arg2(&parser) + 1;
+                    count++;
+                    break;
+                case C_OTHER:
+                    break;
+                default:
+                    count++;
+                    break;
+            }
+        }
+
+        // the native OS keeps its state in the statics of the Jack class,
+        // so native and Jack functions can work on it in turn
+        if (pThis->native) {
+            name = class_name(pThis->files[i]);
+            if ((native = searchNativeClass(name)) >= 0) {
+                pThis->native_statics[native] = VM_STATIC_BASE + pThis->num_statics;
+                if (statics < nativeStatics(native))
+                    statics = nativeStatics(native);
+            }
+            free(name);
+        }
+
+        static_base[i] = pThis->num_statics;
+        pThis->num_statics += statics;
+
+        free(function);
+        parser.del(&parser);
+    }
+
+    // a native class without its Jack version gets statics of its own
+    for (native = 0; pThis->native && native < NUM_NATIVE_CLASSES; native++) {
+        if (pThis->native_statics[native] == 0) {
+            pThis->native_statics[native] = VM_STATIC_BASE + pThis->num_statics;
+            pThis->num_statics += nativeStatics(native);
+        }
+    }
+
+    // return addresses are kept in 16 bit stack slots
+    if (count + 1 > VM_RAM_SIZE) {
+        fprintf(stderr, "Error: program has %d commands, at most %d can be run\n", count, VM_RAM_SIZE - 1);
+        free(static_base);
+        return false;
+    }
+    if (VM_STATIC_BASE + pThis->num_statics > VM_STACK_BASE) {
+        fprintf(stderr, "Error: %d static variables do not fit below the stack\n", pThis->num_statics);
+        free(static_base);
+        return false;
+    }
+
+    pThis->code = (struct vm_instruction *)malloc(sizeof(struct vm_instruction) * (count + 1));
+    pThis->num_code = 0;
+
+    target = search_symbol(pThis, ENTRY_FUNCTION);
+    add_instruction(pThis, OP_CALL, 0, target);
+    add_instruction(pThis, OP_HALT, 0, 0);
+    pThis->entry = target < 0 ? BOOTSTRAP_SIZE : 0;
+
+    // second pass: emit code with every jump and call resolved
+    for (i = 0; i < pThis->num_files; i++) {
+        parser.init(&parser, pThis->files[i]);
+        function = NULL;
+
+        while (parser.hasMoreCommands(&parser)) {
+            parser.advance(&parser);
+            type = parser.commandType(&parser);
+            index = parser.arg2(&parser);
+
+            switch (type) {
+                case C_ARITHMETRIC:
+                    add_instruction(pThis, arithmetic_opcode(parser.arg1(&parser)), 0, 0);
+                    break;
+                case C_PUSH:
+                    switch (parser.segment(&parser)) {
+                        case S_CONSTANT: add_instruction(pThis, OP_PUSH_CONSTANT, 0, index); break;
+                        case S_LOCAL:    add_instruction(pThis, OP_PUSH_LOCAL, 0, index); break;
+                        case S_ARGUMENT: add_instruction(pThis, OP_PUSH_ARGUMENT, 0, index); break;
+                        case S_THIS:     add_instruction(pThis, OP_PUSH_THIS, 0, index); break;
+                        case S_THAT:     add_instruction(pThis, OP_PUSH_THAT, 0, index); break;
+                        case S_POINTER:  add_instruction(pThis, OP_PUSH_ADDR, 0, VM_POINTER_BASE + index); break;
+                        case S_TEMP:     add_instruction(pThis, OP_PUSH_ADDR, 0, VM_TEMP_BASE + index); break;
+                        case S_STATIC:   add_instruction(pThis, OP_PUSH_ADDR, 0, VM_STATIC_BASE + static_base[i] + index); break;
+                        default:
+                            fprintf(stderr, "Error: %s: unknown segment %s\n", pThis->files[i], parser.arg1(&parser));
+                            ok = false;
+                            break;
+                    }
+                    break;
+                case C_POP:
+                    switch (parser.segment(&parser)) {
+                        case S_LOCAL:    add_instruction(pThis, OP_POP_LOCAL, 0, index); break;
+                        case S_ARGUMENT: add_instruction(pThis, OP_POP_ARGUMENT, 0, index); break;
+                        case S_THIS:     add_instruction(pThis, OP_POP_THIS, 0, index); break;
+                        case S_THAT:     add_instruction(pThis, OP_POP_THAT, 0, index); break;
+                        case S_POINTER:  add_instruction(pThis, OP_POP_ADDR, 0, VM_POINTER_BASE + index); break;
+                        case S_TEMP:     add_instruction(pThis, OP_POP_ADDR, 0, VM_TEMP_BASE + index); break;
+                        case S_STATIC:   add_instruction(pThis, OP_POP_ADDR, 0, VM_STATIC_BASE + static_base[i] + index); break;
+                        default:
+                            fprintf(stderr, "Error: %s: cannot pop to segment %s\n", pThis->files[i], parser.arg1(&parser));
+                            ok = false;
+                            break;
+                    }
+                    break;
+                case C_GOTO:
+                case C_IF:
+                    name = scoped_label(function, parser.arg1(&parser));
+                    if ((target = search_symbol(pThis, name)) < 0) {
+                        fprintf(stderr, "Error: %s: label %s is not defined\n", pThis->files[i], name);
+                        ok = false;
+                    }
+                    add_instruction(pThis, type == C_GOTO ? OP_GOTO : OP_IF_GOTO, 0, target);
+                    free(name);
+                    break;
+                case C_FUNCTION:
+                    free(function);
+                    function = (char *)malloc(sizeof(char) * strlen(parser.arg1(&parser)) + 1);
+                    strcpy(function, parser.arg1(&parser));
+                    add_instruction(pThis, OP_FUNCTION, 0, index);
+                    break;
+                case C_CALL:
+                    // Sys.halt never returns, so calling it ends the run
+                    if (!strcmp(parser.arg1(&parser), HALT_FUNCTION)) {
+                        add_instruction(pThis, OP_HALT, 0, 0);
+                        break;
+                    }
+                    if (pThis->native && (native = searchNative(parser.arg1(&parser), index)) >= 0) {
+                        add_instruction(pThis, OP_NATIVE, index, native);
+                        break;
+                    }
+                    if ((target = search_symbol(pThis, parser.arg1(&parser))) < 0) {
+                        fprintf(stderr, "Error: %s: function %s is not defined\n", pThis->files[i], parser.arg1(&parser));
+                        ok = false;
+                    }
+                    add_instruction(pThis, OP_CALL, index, target);
+                    break;
+                case C_RETURN:
+                    add_instruction(pThis, OP_RETURN, 0, 0);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        free(function);
+        parser.del(&parser);
+    }
+
+    // running off the end of the program stops as well
+    add_instruction(pThis, OP_HALT, 0, 0);
+
+    free(static_base);
+
+    return ok;
+}
+
+// replace the hottest command sequences with one instruction each
+void _vm_machine_fuse(VMMachine *pThis)
+{
+    int i, op, length;
+
+    // ops are rewritten in order, so every match still reads unfused
+    // commands; a fused instruction takes its operands from the commands
+    // that follow it, which keep their arg
+    for (i = BOOTSTRAP_SIZE; i < pThis->num_code; i++) {
+        op = fused_opcode(&pThis->code[i], &length);
+        if (op == OP_HALT) continue;
+
+        pThis->code[i].op  = op;
+        pThis->code[i].num = length;
+    }
+
+    return;
+}
+
+// SP, LCL and ARG stay in RAM, where the program can read and write them
+#define SP  (*(uint16_t *)&ram[0])
+#define LCL (*(uint16_t *)&ram[1])
+#define ARG (*(uint16_t *)&ram[2])
+
+unsigned long _vm_machine_run(VMMachine *pThis, unsigned long maxSteps)
+{
+    int16_t *ram = pThis->ram;
+    const struct vm_instruction *code = pThis->code;
+    const struct vm_instruction *in;
+    unsigned long steps;
+    uint16_t frame;
+    int pc = pThis->entry;
+    int16_t x, y;
+    bool jump;
+    int i;
+
+    // jump and call targets are checked when the program is linked; only
+    // a return address comes from RAM
+    for (steps = 0; steps < maxSteps; steps++) {
+        in = &code[pc++];
+
+        switch (in->op) {
+            case OP_PUSH_CONSTANT:
+                ram[SP++] = in->arg;
+                break;
+            case OP_PUSH_LOCAL:
+                x = ram[(uint16_t)(LCL + in->arg)];
+                ram[SP++] = x;
+                break;
+            case OP_PUSH_ARGUMENT:
+                x = ram[(uint16_t)(ARG + in->arg)];
+                ram[SP++] = x;
+                break;
+            case OP_PUSH_THIS:
+                x = ram[(uint16_t)(ram[3] + in->arg)];
+                ram[SP++] = x;
+                break;
+            case OP_PUSH_THAT:
+                x = ram[(uint16_t)(ram[4] + in->arg)];
+                ram[SP++] = x;
+                break;
+            case OP_PUSH_ADDR:
+                x = ram[in->arg];
+                ram[SP++] = x;
+                break;
+            case OP_POP_LOCAL:
+                x = ram[--SP];
+                ram[(uint16_t)(LCL + in->arg)] = x;
+                break;
+            case OP_POP_ARGUMENT:
+                x = ram[--SP];
+                ram[(uint16_t)(ARG + in->arg)] = x;
+                break;
+            case OP_POP_THIS:
+                x = ram[--SP];
+                ram[(uint16_t)(ram[3] + in->arg)] = x;
+                break;
+            case OP_POP_THAT:
+                x = ram[--SP];
+                ram[(uint16_t)(ram[4] + in->arg)] = x;
+                break;
+            case OP_POP_ADDR:
+                x = ram[--SP];
+                ram[in->arg] = x;
+                break;
+            case OP_ADD:
+                y = ram[--SP];
+                ram[(uint16_t)(SP - 1)] = (int16_t)(ram[(uint16_t)(SP - 1)] + y);
+                break;
+            case OP_SUB:
+                y = ram[--SP];
+                ram[(uint16_t)(SP - 1)] = (int16_t)(ram[(uint16_t)(SP - 1)] - y);
+                break;
+            case OP_NEG:
+                ram[(uint16_t)(SP - 1)] = (int16_t)-ram[(uint16_t)(SP - 1)];
+                break;
+            // compare the 16 bit difference, exactly like the translated code
+            case OP_EQ:
+                y = ram[--SP];
+                ram[(uint16_t)(SP - 1)] = (int16_t)(ram[(uint16_t)(SP - 1)] - y) == 0 ? -1 : 0;
+                break;
+            case OP_GT:
+                y = ram[--SP];
+                ram[(uint16_t)(SP - 1)] = (int16_t)(ram[(uint16_t)(SP - 1)] - y) > 0 ? -1 : 0;
+                break;
+            case OP_LT:
+                y = ram[--SP];
+                ram[(uint16_t)(SP - 1)] = (int16_t)(ram[(uint16_t)(SP - 1)] - y) < 0 ? -1 : 0;
+                break;
+            case OP_AND:
+                y = ram[--SP];
+                ram[(uint16_t)(SP - 1)] &= y;
+                break;
+            case OP_OR:
+                y = ram[--SP];
+                ram[(uint16_t)(SP - 1)] |= y;
+                break;
+            case OP_NOT:
+                ram[(uint16_t)(SP - 1)] = ~ram[(uint16_t)(SP - 1)];
+                break;
+            case OP_GOTO:
+                pc = in->arg;
+                break;
+            case OP_IF_GOTO:
+                if (ram[--SP] != 0) pc = in->arg;
+                break;
+            case OP_FUNCTION:
+                for (i = 0; i < in->arg; i++)
+                    ram[SP++] = 0;
+                break;
+            case OP_CALL:
+                ram[SP++] = (int16_t)pc;
+                x = LCL; ram[SP++] = x;
+                x = ARG; ram[SP++] = x;
+                x = ram[3]; ram[SP++] = x;
+                x = ram[4]; ram[SP++] = x;
+                ARG = SP - in->num - 5;
+                LCL = SP;
+                pc  = in->arg;
+                break;
+            case OP_RETURN:
+                frame = LCL;
+                pc = (uint16_t)ram[(uint16_t)(frame - 5)];
+                x = ram[--SP];
+                ram[ARG] = x;
+                SP = ARG + 1;
+                ram[4] = ram[(uint16_t)(frame - 1)];
+                ram[3] = ram[(uint16_t)(frame - 2)];
+                ARG    = ram[(uint16_t)(frame - 3)];
+                LCL    = ram[(uint16_t)(frame - 4)];
+                // on Hack the program would run on in whatever the ROM
+                // holds there; here it stops
+                if (pc >= pThis->num_code) {
+                    fprintf(stderr, "VMinterpreter: return to %d, outside the program of %d commands\n",
+                            pc, pThis->num_code);
+                    pc = pThis->num_code - 1;
+                    steps++;
+                    goto halt;
+                }
+                break;
+
+            // a fused instruction counts as the commands it covers, so a
+            // step limit may be overrun by the rest of the last sequence
+            case OP_NOT_IF_GOTO:
+                steps++;
+                pc++;
+                if (ram[--SP] != -1) pc = in[1].arg;
+                break;
+            case OP_EQ_IF_GOTO:
+            case OP_GT_IF_GOTO:
+            case OP_LT_IF_GOTO:
+                steps += in->num - 1;
+                pc    += in->num - 1;
+                y = ram[--SP];
+                x = (int16_t)(ram[--SP] - y);
+                if (in->op == OP_EQ_IF_GOTO)
+                    jump = x == 0;
+                else if (in->op == OP_GT_IF_GOTO)
+                    jump = x > 0;
+                else
+                    jump = x < 0;
+                if (jump != (in->num == 3)) pc = in[in->num - 1].arg;
+                break;
+            case OP_ADD_POP_LOCAL:
+                steps++;
+                pc++;
+                y = ram[--SP];
+                x = ram[--SP];
+                ram[(uint16_t)(LCL + in[1].arg)] = (int16_t)(x + y);
+                break;
+            case OP_POP_LOCAL_GOTO:
+                steps++;
+                x = ram[--SP];
+                ram[(uint16_t)(LCL + in->arg)] = x;
+                pc = in[1].arg;
+                break;
+            case OP_PUSH_LOCAL_CONSTANT:
+                steps++;
+                pc++;
+                x = ram[(uint16_t)(LCL + in->arg)];
+                ram[SP++] = x;
+                ram[SP++] = in[1].arg;
+                break;
+            case OP_PUSH_LOCAL_LOCAL:
+                steps++;
+                pc++;
+                x = ram[(uint16_t)(LCL + in->arg)];
+                ram[SP++] = x;
+                x = ram[(uint16_t)(LCL + in[1].arg)];
+                ram[SP++] = x;
+                break;
+            case OP_PUSH_LOCAL_ADD:
+                steps++;
+                pc++;
+                x = ram[(uint16_t)(LCL + in->arg)];
+                ram[(uint16_t)(SP - 1)] = (int16_t)(ram[(uint16_t)(SP - 1)] + x);
+                break;
+            case OP_PUSH_CONSTANT_NEG:
+                steps++;
+                pc++;
+                ram[SP++] = (int16_t)-in->arg;
+                break;
+            case OP_NATIVE:
+                SP -= in->num;
+                if (!callNative(pThis, in->arg, &ram[SP], &x)) {
+                    pc--;
+                    goto halt;
+                }
+                ram[SP++] = x;
+                break;
+            case OP_HALT:
+            default:
+                pc--;
+                goto halt;
+        }
+    }
+
+halt:
+    pThis->entry = pc;
+
+    return steps;
+}
+
+#undef SP
+#undef LCL
+#undef ARG
+
+void _vm_machine_del(VMMachine *pThis)
+{
+    int i;
+
+    for (i = 0; i < pThis->size_symbols; i++)
+        free(pThis->symbols[i].name);
+    for (i = 0; i < pThis->num_files; i++)
+        free(pThis->files[i]);
+
+    free(pThis->symbols);
+    free(pThis->files);
+    free(pThis->code);
+    free(pThis->ram);
+    pThis->symbols = NULL;
+    pThis->files = NULL;
+    pThis->code = NULL;
+    pThis->ram = NULL;
+    pThis->num_symbols = 0;
+    pThis->size_symbols = 0;
+    pThis->num_files = 0;
+    pThis->num_code = 0;
+
+    return;
+}
+
+static void add_instruction(VMMachine *pThis, int op, int num, int arg)
+{
+    struct vm_instruction *in = &pThis->code[pThis->num_code++];
+
+    in->op  = op;
+    in->num = num;
+    in->arg = arg;
+
+    return;
+}
+
+// functions and scoped labels share one open addressing table
+static bool add_symbol(VMMachine *pThis, char *name, int target)
+{
+    struct vm_symbol *old = pThis->symbols;
+    int old_size = pThis->size_symbols;
+    unsigned long i;
+    int j;
+
+    if (search_symbol(pThis, name) >= 0) return false;
+
+    if ((pThis->num_symbols + 1) * 2 > pThis->size_symbols) {
+        pThis->size_symbols *= 2;
+        pThis->symbols = (struct vm_symbol *)calloc(pThis->size_symbols, sizeof(struct vm_symbol));
+        pThis->num_symbols = 0;
+        for (j = 0; j < old_size; j++) {
+            if (old[j].name == NULL) continue;
+            i = hash_symbol(old[j].name) & (pThis->size_symbols - 1);
+            while (pThis->symbols[i].name != NULL)
+                i = (i + 1) & (pThis->size_symbols - 1);
+            pThis->symbols[i] = old[j];
+            pThis->num_symbols++;
+        }
+        free(old);
+    }
+
+    i = hash_symbol(name) & (pThis->size_symbols - 1);
+    while (pThis->symbols[i].name != NULL)
+        i = (i + 1) & (pThis->size_symbols - 1);
+
+    pThis->symbols[i].name = (char *)malloc(sizeof(char) * strlen(name) + 1);
+    strcpy(pThis->symbols[i].name, name);
+    pThis->symbols[i].target = target;
+    pThis->num_symbols++;
+
+    return true;
+}
+
+static int search_symbol(VMMachine *pThis, char *name)
+{
+    unsigned long i;
+
+    i = hash_symbol(name) & (pThis->size_symbols - 1);
+    while (pThis->symbols[i].name != NULL) {
+        if (!strcmp(pThis->symbols[i].name, name))
+            return pThis->symbols[i].target;
+        i = (i + 1) & (pThis->size_symbols - 1);
+    }
+
+    return -1;
+}
+
+static unsigned long hash_symbol(const char *name)
+{
+    unsigned long hash = 2166136261UL;
+
+    while (*name != '\0') {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619UL;
+    }
+
+    return hash;
+}
+
+// labels are scoped to their function, as in the translated code
+static char *scoped_label(char *function, char *label)
+{
+    char *func = function ? function : "null";
+    char *name;
+
+    name = (char *)malloc(sizeof(char) * (strlen(func) + strlen(label) + 2));
+    sprintf(name, "%s$%s", func, label);
+
+    return name;
+}
+
+// the class of a VM file is its name without directory and extension
+static char *class_name(const char *path)
+{
+    const char *base = strrchr(path, '/');
+    char *name, *dot;
+
+    base = base ? base + 1 : path;
+    name = (char *)malloc(sizeof(char) * strlen(base) + 1);
+    strcpy(name, base);
+    if ((dot = strrchr(name, '.')) != NULL)
+        *dot = '\0';
+
+    return name;
+}
+
+static int arithmetic_opcode(char *command)
+{
+    static const struct {
+        char *command;
+        int  op;
+    } op_list[] = {
+        {"add", OP_ADD}, {"sub", OP_SUB}, {"neg", OP_NEG},
+        {"eq",  OP_EQ},  {"gt",  OP_GT},  {"lt",  OP_LT},
+        {"and", OP_AND}, {"or",  OP_OR},  {"not", OP_NOT},
+        {NULL,  OP_HALT},
+    };
+
+    int i;
+
+    for (i = 0; op_list[i].command != NULL; i++)
+        if (!strcmp(command, op_list[i].command))
+            return op_list[i].op;
+
+    return OP_HALT;
+}
+
+// the superinstruction starting at in, or OP_HALT if there is none
+static int fused_opcode(const struct vm_instruction *in, int *length)
+{
+    *length = 2;
+
+    switch (in[0].op) {
+        case OP_NOT:
+            if (in[1].op == OP_IF_GOTO) return OP_NOT_IF_GOTO;
+            break;
+        case OP_EQ:
+        case OP_GT:
+        case OP_LT:
+            if (in[1].op == OP_NOT && in[2].op == OP_IF_GOTO)
+                *length = 3;
+            else if (in[1].op != OP_IF_GOTO)
+                break;
+            return in[0].op == OP_EQ ? OP_EQ_IF_GOTO : in[0].op == OP_GT ? OP_GT_IF_GOTO : OP_LT_IF_GOTO;
+        case OP_ADD:
+            if (in[1].op == OP_POP_LOCAL) return OP_ADD_POP_LOCAL;
+            break;
+        case OP_POP_LOCAL:
+            if (in[1].op == OP_GOTO) return OP_POP_LOCAL_GOTO;
+            break;
+        case OP_PUSH_LOCAL:
+            if (in[1].op == OP_PUSH_CONSTANT) return OP_PUSH_LOCAL_CONSTANT;
+            if (in[1].op == OP_PUSH_LOCAL)    return OP_PUSH_LOCAL_LOCAL;
+            if (in[1].op == OP_ADD)           return OP_PUSH_LOCAL_ADD;
+            break;
+        case OP_PUSH_CONSTANT:
+            if (in[1].op == OP_NEG) return OP_PUSH_CONSTANT_NEG;
+            break;
+        default:
+            break;
+    }
+
+    return OP_HALT;
+}
@@ -0,0 +1,131 @@
+/*
+ * vm_machine.h
+ */
+
+#ifndef _VM_MACHINE_H_
+#define _VM_MACHINE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "command_type.h"
+
+// the Hack memory map; RAM is 64K words so any 16 bit address is in range
+#define VM_RAM_SIZE      65536
+#define VM_STACK_BASE    256
+#define VM_STATIC_BASE   16
+#define VM_TEMP_BASE     5
+#define VM_POINTER_BASE  3
+
+// the OS classes whose native functions keep state in their statics
+enum nativeClass {
+    NATIVE_MATH,
+    NATIVE_MEMORY,
+    NUM_NATIVE_CLASSES,
+};
+
+enum vmOpcode {
+    OP_PUSH_CONSTANT,
+    OP_PUSH_LOCAL,
+    OP_PUSH_ARGUMENT,
+    OP_PUSH_THIS,
+    OP_PUSH_THAT,
+    OP_PUSH_ADDR,           // pointer, temp and static resolve to an address
+    OP_POP_LOCAL,
+    OP_POP_ARGUMENT,
+    OP_POP_THIS,
+    OP_POP_THAT,
+    OP_POP_ADDR,
+    OP_ADD,
+    OP_SUB,
+    OP_NEG,
+    OP_EQ,
+    OP_GT,
+    OP_LT,
+    OP_AND,
+    OP_OR,
+    OP_NOT,
+    OP_GOTO,
+    OP_IF_GOTO,
+    OP_FUNCTION,
+    OP_CALL,
+    OP_RETURN,
+    OP_NATIVE,              // an OS function built into the interpreter
+    OP_HALT,
+
+    // superinstructions; fuse() writes them over the first command of a
+    // sequence and leaves the rest in place, so jumps into it still work
+    OP_NOT_IF_GOTO,         // not; if-goto
+    OP_EQ_IF_GOTO,          // eq [not]; if-goto
+    OP_GT_IF_GOTO,          // gt [not]; if-goto
+    OP_LT_IF_GOTO,          // lt [not]; if-goto
+    OP_ADD_POP_LOCAL,       // add; pop local
+    OP_POP_LOCAL_GOTO,      // pop local; goto
+    OP_PUSH_LOCAL_CONSTANT, // push local; push constant
+    OP_PUSH_LOCAL_LOCAL,    // push local; push local
+    OP_PUSH_LOCAL_ADD,      // push local; add
+    OP_PUSH_CONSTANT_NEG,   // push constant; neg
+    NUM_OPCODES,
+};
+
+struct vm_instruction {
+    int16_t op;
+    int16_t num;            // call: number of arguments, fused: commands covered
+    int32_t arg;            // constant, segment index, address, jump target or native
+};
+
+struct vm_symbol {
+    char *name;
+    int  target;
+};
+
+typedef struct vm_machine {
+    int16_t *ram;
+    struct vm_instruction *code;
+    int  num_code;
+    struct vm_symbol *symbols;
+    int  num_symbols;
+    int  size_symbols;
+    char **files;
+    int  num_files;
+    int  num_statics;
+    int  entry;
+    bool native;            // bind OS calls to vm_native.c at link time
+    int  native_statics[NUM_NATIVE_CLASSES];   // RAM address of the statics of each
+
+    void (*init)(struct vm_machine *);
+    void (*addFile)(struct vm_machine *, char *);
+    bool (*link)(struct vm_machine *);
+    void (*fuse)(struct vm_machine *);
+    unsigned long (*run)(struct vm_machine *, unsigned long);
+    void (*del)(struct vm_machine *);
+} VMMachine;
+
+extern void _vm_machine_init(VMMachine *pThis);
+extern void _vm_machine_addFile(VMMachine *pThis, char *path);
+extern bool _vm_machine_link(VMMachine *pThis);
+extern void _vm_machine_fuse(VMMachine *pThis);
+extern unsigned long _vm_machine_run(VMMachine *pThis, unsigned long maxSteps);
+extern void _vm_machine_del(VMMachine *pThis);
+
+#define newVMMachine() {                    \
+    .ram          = NULL,                   \
+    .code         = NULL,                   \
+    .num_code     = 0,                      \
+    .symbols      = NULL,                   \
+    .num_symbols  = 0,                      \
+    .size_symbols = 0,                      \
+    .files        = NULL,                   \
+    .num_files    = 0,                      \
+    .num_statics  = 0,                      \
+    .entry        = 0,                      \
+    .native       = false,                  \
+    .native_statics = {0},                  \
+    .init         = _vm_machine_init,       \
+    .addFile      = _vm_machine_addFile,    \
+    .link         = _vm_machine_link,       \
+    .fuse         = _vm_machine_fuse,       \
+    .run          = _vm_machine_run,        \
+    .del          = _vm_machine_del,        \
+}
+
+#endif
@@ -0,0 +1,480 @@
+/*
+ * vm_native.c
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "vm_native.h"
+
+// the same algorithms as 12/*.jack, in 16 bit arithmetic, so results and
+// heap layout are exactly those of the Jack OS
+#define HEAP_BASE    2048
+#define HEAP_LENGTH  14336
+
+// String fields, in declaration order
+#define STRING_STR      0
+#define STRING_LENGTH   1
+#define STRING_MAX      2
+#define STRING_FIELDS   3
+
+// the statics of Math and Memory in declaration order; the native functions
+// keep the state of the OS where the Jack classes keep it
+#define MATH_TWO_TO_THE     0
+#define MATH_STATICS        1
+#define MEMORY_HEAP_BASE    0
+#define MEMORY_HEAP_LENGTH  1
+#define MEMORY_FREE_LIST    2
+#define MEMORY_STATICS      3
+
+// Math.divide doubles y once per level; compared as a 16 bit difference the
+// way Hack's D=x-y;D;JLT does, a y that overflows to -32768 or 0 is above
+// any x, so every nonzero y stops within 16 levels and only y = 0 is deeper
+#define MAX_DIVIDE_DEPTH 17
+
+#define RAM(addr) (machine->ram[(uint16_t)(addr)])
+#define STATIC(class, index) RAM(machine->native_statics[class] + (index))
+
+// the VM compares the sign of the 16 bit difference, not the values
+#define LT(x, y) ((int16_t)((x) - (y)) < 0)
+#define GT(x, y) ((int16_t)((x) - (y)) > 0)
+
+typedef bool (*native_function)(VMMachine *, int16_t *, int16_t *);
+
+static bool math_init(VMMachine *machine, int16_t *args, int16_t *result);
+static bool math_abs(VMMachine *machine, int16_t *args, int16_t *result);
+static bool math_multiply(VMMachine *machine, int16_t *args, int16_t *result);
+static bool math_bit(VMMachine *machine, int16_t *args, int16_t *result);
+static bool math_divide(VMMachine *machine, int16_t *args, int16_t *result);
+static bool math_sqrt(VMMachine *machine, int16_t *args, int16_t *result);
+static bool math_max(VMMachine *machine, int16_t *args, int16_t *result);
+static bool math_min(VMMachine *machine, int16_t *args, int16_t *result);
+
+static bool memory_init(VMMachine *machine, int16_t *args, int16_t *result);
+static bool memory_peek(VMMachine *machine, int16_t *args, int16_t *result);
+static bool memory_poke(VMMachine *machine, int16_t *args, int16_t *result);
+static bool memory_alloc(VMMachine *machine, int16_t *args, int16_t *result);
+static bool memory_deAlloc(VMMachine *machine, int16_t *args, int16_t *result);
+
+static bool string_new(VMMachine *machine, int16_t *args, int16_t *result);
+static bool string_dispose(VMMachine *machine, int16_t *args, int16_t *result);
+static bool string_length(VMMachine *machine, int16_t *args, int16_t *result);
+static bool string_charAt(VMMachine *machine, int16_t *args, int16_t *result);
+static bool string_setCharAt(VMMachine *machine, int16_t *args, int16_t *result);
+static bool string_appendChar(VMMachine *machine, int16_t *args, int16_t *result);
+static bool string_eraseLastChar(VMMachine *machine, int16_t *args, int16_t *result);
+static bool string_intValue(VMMachine *machine, int16_t *args, int16_t *result);
+static bool string_setInt(VMMachine *machine, int16_t *args, int16_t *result);
+static bool string_newLine(VMMachine *machine, int16_t *args, int16_t *result);
+static bool string_backSpace(VMMachine *machine, int16_t *args, int16_t *result);
+static bool string_doubleQuote(VMMachine *machine, int16_t *args, int16_t *result);
+
+static bool    divide(int16_t x, int16_t y, int16_t *result, int depth);
+static int16_t alloc(VMMachine *machine, int16_t size);
+static bool    deAlloc(VMMachine *machine, int16_t o);
+static void    append_char(VMMachine *machine, int16_t this, int16_t c);
+static void    set_int(VMMachine *machine, int16_t this, int16_t val);
+
+static const struct {
+    char *name;
+    int  num_args;
+    native_function function;
+} native_list[] = {
+    {"Math.init",            0, math_init},
+    {"Math.abs",             1, math_abs},
+    {"Math.multiply",        2, math_multiply},
+    {"Math.bit",             2, math_bit},
+    {"Math.divide",          2, math_divide},
+    {"Math.sqrt",            1, math_sqrt},
+    {"Math.max",             2, math_max},
+    {"Math.min",             2, math_min},
+    {"Memory.init",          0, memory_init},
+    {"Memory.peek",          1, memory_peek},
+    {"Memory.poke",          2, memory_poke},
+    {"Memory.alloc",         1, memory_alloc},
+    {"Memory.deAlloc",       1, memory_deAlloc},
+    {"Array.new",            1, memory_alloc},
+    {"Array.dispose",        1, memory_deAlloc},
+    {"String.new",           1, string_new},
+    {"String.dispose",       1, string_dispose},
+    {"String.length",        1, string_length},
+    {"String.charAt",        2, string_charAt},
+    {"String.setCharAt",     3, string_setCharAt},
+    {"String.appendChar",    2, string_appendChar},
+    {"String.eraseLastChar", 1, string_eraseLastChar},
+    {"String.intValue",      1, string_intValue},
+    {"String.setInt",        2, string_setInt},
+    {"String.newLine",       0, string_newLine},
+    {"String.backSpace",     0, string_backSpace},
+    {"String.doubleQuote",   0, string_doubleQuote},
+    {NULL,                   0, NULL},
+};
+
+static const struct {
+    char *name;
+    int  num_statics;
+} native_classes[NUM_NATIVE_CLASSES] = {
+    [NATIVE_MATH]   = {"Math",   MATH_STATICS},
+    [NATIVE_MEMORY] = {"Memory", MEMORY_STATICS},
+};
+
+int searchNativeClass(const char *name)
+{
+    int i;
+
+    for (i = 0; i < NUM_NATIVE_CLASSES; i++)
+        if (!strcmp(name, native_classes[i].name))
+            return i;
+
+    return -1;
+}
+
+int nativeStatics(int nativeClass)
+{
+    return native_classes[nativeClass].num_statics;
+}
+
+int searchNative(const char *name, int numArgs)
+{
+    int i;
+
+    for (i = 0; native_list[i].name != NULL; i++)
+        if (!strcmp(name, native_list[i].name) && numArgs == native_list[i].num_args)
+            return i;
+
+    return -1;
+}
+
+bool callNative(VMMachine *machine, int index, int16_t *args, int16_t *result)
+{
+    *result = 0;            // void functions return 0
+
+    return native_list[index].function(machine, args, result);
+}
+
+static bool math_init(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    int16_t two_to_the = alloc(machine, 16);
+    int i;
+
+    for (i = 0; i < 16; i++)
+        RAM(two_to_the + i) = (int16_t)(1 << i);
+    STATIC(NATIVE_MATH, MATH_TWO_TO_THE) = two_to_the;
+
+    return true;
+}
+
+static bool math_abs(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    *result = LT(args[0], 0) ? (int16_t)-args[0] : args[0];
+
+    return true;
+}
+
+static bool math_multiply(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    *result = (int16_t)(args[0] * args[1]);
+
+    return true;
+}
+
+static bool math_bit(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    int16_t two_to_the = STATIC(NATIVE_MATH, MATH_TWO_TO_THE);
+
+    *result = (args[0] & RAM(two_to_the + args[1])) != 0 ? -1 : 0;
+
+    return true;
+}
+
+static bool math_divide(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    // the Jack version recurses until the stack runs over the heap, which
+    // only a zero divisor makes it do
+    if (!divide(args[0], args[1], result, 0)) {
+        fprintf(stderr, "Error: Math.divide(%d, %d) does not return\n", args[0], args[1]);
+        return false;
+    }
+
+    return true;
+}
+
+static bool math_sqrt(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    int16_t x = args[0], y = 0, tmp;
+    int i;
+
+    for (i = 8; i >= 0; i--) {
+        tmp = (int16_t)((y + (1 << i)) * (y + (1 << i)));
+        if ((LT(tmp, x) || tmp == x) && GT(tmp, 0))
+            y = (int16_t)(y + (1 << i));
+    }
+
+    *result = y;
+
+    return true;
+}
+
+static bool math_max(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    *result = GT(args[0], args[1]) ? args[0] : args[1];
+
+    return true;
+}
+
+static bool math_min(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    *result = GT(args[0], args[1]) ? args[1] : args[0];
+
+    return true;
+}
+
+static bool memory_init(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    STATIC(NATIVE_MEMORY, MEMORY_HEAP_BASE)   = HEAP_BASE;
+    STATIC(NATIVE_MEMORY, MEMORY_HEAP_LENGTH) = HEAP_LENGTH;
+    STATIC(NATIVE_MEMORY, MEMORY_FREE_LIST)   = HEAP_BASE;
+    RAM(HEAP_BASE)     = HEAP_LENGTH;
+    RAM(HEAP_BASE + 1) = 0;
+
+    return true;
+}
+
+static bool memory_peek(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    *result = RAM(args[0]);
+
+    return true;
+}
+
+static bool memory_poke(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    RAM(args[0]) = args[1];
+
+    return true;
+}
+
+static bool memory_alloc(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    *result = alloc(machine, args[0]);
+
+    return true;
+}
+
+static bool memory_deAlloc(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    return deAlloc(machine, args[0]);
+}
+
+static bool string_new(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    int16_t this, max = args[0];
+
+    this = alloc(machine, STRING_FIELDS);
+    if (max == 0) max = 1;
+    RAM(this + STRING_STR)    = alloc(machine, max);
+    RAM(this + STRING_LENGTH) = 0;
+    RAM(this + STRING_MAX)    = max;
+
+    *result = this;
+
+    return true;
+}
+
+static bool string_dispose(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    return deAlloc(machine, RAM(args[0] + STRING_STR));
+}
+
+static bool string_length(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    *result = RAM(args[0] + STRING_LENGTH);
+
+    return true;
+}
+
+static bool string_charAt(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    int16_t this = args[0], j = args[1];
+
+    if (LT(j, RAM(this + STRING_MAX)))
+        *result = RAM(RAM(this + STRING_STR) + j);
+
+    return true;
+}
+
+static bool string_setCharAt(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    int16_t this = args[0], j = args[1];
+
+    if (LT(j, RAM(this + STRING_MAX)))
+        RAM(RAM(this + STRING_STR) + j) = args[2];
+
+    return true;
+}
+
+static bool string_appendChar(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    append_char(machine, args[0], args[1]);
+    *result = args[0];
+
+    return true;
+}
+
+static bool string_eraseLastChar(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    int16_t this = args[0];
+
+    if (RAM(this + STRING_LENGTH) != 0)
+        RAM(this + STRING_LENGTH)--;
+
+    return true;
+}
+
+static bool string_intValue(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    int16_t this = args[0], str = RAM(this + STRING_STR), v = 0, c;
+    int16_t i;
+
+    for (i = 0; LT(i, RAM(this + STRING_LENGTH)); i++) {
+        c = RAM(str + i);
+        if (GT(c, 47) && LT(c, 58))
+            v = (int16_t)(v * 10 + (c - 48));
+    }
+
+    if (RAM(str) == 45)
+        v = (int16_t)-v;
+
+    *result = v;
+
+    return true;
+}
+
+static bool string_setInt(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    set_int(machine, args[0], args[1]);
+
+    return true;
+}
+
+static bool string_newLine(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    *result = 128;
+
+    return true;
+}
+
+static bool string_backSpace(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    *result = 129;
+
+    return true;
+}
+
+static bool string_doubleQuote(VMMachine *machine, int16_t *args, int16_t *result)
+{
+    *result = 34;
+
+    return true;
+}
+
+static bool divide(int16_t x, int16_t y, int16_t *result, int depth)
+{
+    int16_t q, a, sign = 1;
+
+    if (LT(x, 0)) {sign = -sign; x = (int16_t)-x;}
+    if (LT(y, 0)) {sign = -sign; y = (int16_t)-y;}
+
+    if (LT(x, y)) {
+        *result = 0;
+        return true;
+    }
+
+    if (depth == MAX_DIVIDE_DEPTH || !divide(x, (int16_t)(2 * y), &q, depth + 1))
+        return false;
+
+    a = (int16_t)(-2 * q * y + x);
+    if (LT(a, y))
+        *result = (int16_t)(sign * 2 * q);
+    else
+        *result = (int16_t)(sign * 2 * q + 1);
+
+    return true;
+}
+
+// first fit from the end of a free block, as Memory.alloc does
+static int16_t alloc(VMMachine *machine, int16_t size)
+{
+    int16_t segment = STATIC(NATIVE_MEMORY, MEMORY_FREE_LIST), block;
+    int count;
+
+    for (count = 0; segment != 0 && count < VM_RAM_SIZE; count++) {
+        if (GT(RAM(segment), size)) {
+            RAM(segment) = (int16_t)(RAM(segment) - (size + 1));
+
+            block = (int16_t)(segment + RAM(segment) + 1);
+            RAM(block - 1) = (int16_t)(size + 1);
+
+            return block;
+        }
+
+        segment = RAM(segment + 1);
+    }
+
+    return 0;
+}
+
+static bool deAlloc(VMMachine *machine, int16_t o)
+{
+    int16_t segment = STATIC(NATIVE_MEMORY, MEMORY_FREE_LIST);
+    int count;
+
+    for (count = 0; RAM(segment + 1) != 0; count++) {
+        // a block freed twice closes the list into a loop
+        if (count == VM_RAM_SIZE) {
+            fprintf(stderr, "Error: Memory.deAlloc(%d) : free list has a cycle\n", o);
+            return false;
+        }
+        segment = RAM(segment + 1);
+    }
+
+    RAM(segment + 1) = (int16_t)(o - 1);
+
+    return true;
+}
+
+static void append_char(VMMachine *machine, int16_t this, int16_t c)
+{
+    int16_t len = RAM(this + STRING_LENGTH);
+
+    if (LT(len, RAM(this + STRING_MAX))) {
+        RAM(RAM(this + STRING_STR) + len) = c;
+        RAM(this + STRING_LENGTH) = (int16_t)(len + 1);
+    }
+
+    return;
+}
+
+static void set_int(VMMachine *machine, int16_t this, int16_t val)
+{
+    int16_t abs_val = LT(val, 0) ? (int16_t)-val : val;
+    int16_t tenth, last_digit, c;
+
+    RAM(this + STRING_LENGTH) = 0;
+
+    // dividing by 10 always returns
+    divide(abs_val, 10, &tenth, 0);
+    last_digit = (int16_t)(abs_val - tenth * 10);
+    c = (int16_t)(last_digit + 48);
+
+    if (LT(abs_val, 10)) {
+        if (LT(val, 0)) append_char(machine, this, 45);
+        append_char(machine, this, c);
+    } else {
+        divide(val, 10, &tenth, 0);
+        set_int(machine, this, tenth);
+        append_char(machine, this, c);
+    }
+
+    return;
+}
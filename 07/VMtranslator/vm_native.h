@@ -0,0 +1,23 @@
+/*
+ * vm_native.h
+ */
+
+#ifndef _VM_NATIVE_H_
+#define _VM_NATIVE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "vm_machine.h"
+
+// the index of the native version of an OS function, or -1 if it has none
+extern int  searchNative(const char *name, int numArgs);
+
+// the native class of a class name, or -1, and the statics it shares with
+// the Jack version of the class
+extern int  searchNativeClass(const char *name);
+extern int  nativeStatics(int nativeClass);
+
+// runs a native function on args[0..numArgs-1]; false stops the machine
+extern bool callNative(VMMachine *machine, int index, int16_t *args, int16_t *result);
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * vminterpreter.c
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vm_machine.h"
+#include "file_list.h"
+
+#define MAX_DUMPS 16
+#define NUM_PROFILE_PAIRS 20
+
+struct ram_range {
+    int first;
+    int last;
+};
+
+static unsigned long profilePairs(VMMachine *machine, unsigned long maxSteps);
+
+int main(int argc, char **argv)
+{
+    VMMachine machine = newVMMachine();
+    FileList file_list = newFileList();
+    struct ram_range dumps[MAX_DUMPS];
+    struct timespec start, end;
+    unsigned long max_steps = ULONG_MAX, steps;
+    double seconds;
+    int num_dumps = 0;
+    int opt, i, j, addr, value;
+    bool verbose = false, profile = false;
+
+    machine.init(&machine);
+    machine.ram[0] = VM_STACK_BASE;
+
+    while ((opt = getopt(argc, argv, "n:r:d:vpo")) != -1) {
+        switch (opt) {
+            case 'n':
+                max_steps = strtoul(optarg, NULL, 10);
+                break;
+            case 'r':
+                if (sscanf(optarg, "%d=%d", &addr, &value) != 2 || addr < 0 || addr >= VM_RAM_SIZE) {
+                    printf("Error: -r expects addr=value\n");
+                    return 1;
+                }
+                machine.ram[addr] = value;
+                break;
+            case 'd':
+                if (num_dumps == MAX_DUMPS) break;
+                if (sscanf(optarg, "%d-%d", &dumps[num_dumps].first, &dumps[num_dumps].last) != 2)
+                    dumps[num_dumps].last = dumps[num_dumps].first = atoi(optarg);
+                if (dumps[num_dumps].first < 0 || dumps[num_dumps].last >= VM_RAM_SIZE) {
+                    printf("Error: -d expects addresses below %d\n", VM_RAM_SIZE);
+                    return 1;
+                }
+                num_dumps++;
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            case 'p':
+                profile = true;
+                break;
+            case 'o':
+                machine.native = true;
+                break;
+            default:
+                printf("Usage: %s [-n steps] [-r addr=value]... [-d first-last]... [-v] [-p] [-o] source\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (argc - optind != 1) {
+        printf("Error: argument is invalid\n");
+        return 1;
+    }
+
+    // the files of a directory are linked in name order, as VMtranslator
+    // lays them out
+    file_list.init(&file_list, "vm");
+    file_list.add(&file_list, argv[optind]);
+    if (file_list.num_files == 0) {
+        printf("Error: no .vm files in %s\n", argv[optind]);
+        return 1;
+    }
+    for (i = 0; i < file_list.num_files; i++)
+        machine.addFile(&machine, file_list.filenames[i].fullname);
+    file_list.del(&file_list);
+
+    if (!machine.link(&machine)) {
+        machine.del(&machine);
+        return 1;
+    }
+
+    // profiling counts the commands as written, so nothing is fused
+    if (!profile)
+        machine.fuse(&machine);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (profile)
+        steps = profilePairs(&machine, max_steps);
+    else
+        steps = machine.run(&machine, max_steps);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    printf("steps=%lu\n", steps);
+    for (i = 0; i < num_dumps; i++) {
+        printf("RAM[%d..%d]:", dumps[i].first, dumps[i].last);
+        for (j = dumps[i].first; j <= dumps[i].last; j++)
+            printf(" %d", machine.ram[j]);
+        printf("\n");
+    }
+
+    if (verbose) {
+        seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        fprintf(stderr, "%lu steps in %.3f s (%.1f M steps/s)\n",
+                steps, seconds, seconds > 0 ? steps / seconds / 1e6 : 0.0);
+    }
+
+    machine.del(&machine);
+
+    return 0;
+}
+
+// run one command at a time and report the most frequent pairs of opcodes,
+// the candidates for new superinstructions
+static unsigned long profilePairs(VMMachine *machine, unsigned long maxSteps)
+{
+    static const char *names[NUM_OPCODES] = {
+        [OP_PUSH_CONSTANT] = "push constant", [OP_PUSH_LOCAL]    = "push local",
+        [OP_PUSH_ARGUMENT] = "push argument", [OP_PUSH_THIS]     = "push this",
+        [OP_PUSH_THAT]     = "push that",     [OP_PUSH_ADDR]     = "push static/temp/pointer",
+        [OP_POP_LOCAL]     = "pop local",     [OP_POP_ARGUMENT]  = "pop argument",
+        [OP_POP_THIS]      = "pop this",      [OP_POP_THAT]      = "pop that",
+        [OP_POP_ADDR]      = "pop static/temp/pointer",
+        [OP_ADD] = "add", [OP_SUB] = "sub", [OP_NEG] = "neg",
+        [OP_EQ]  = "eq",  [OP_GT]  = "gt",  [OP_LT]  = "lt",
+        [OP_AND] = "and", [OP_OR]  = "or",  [OP_NOT] = "not",
+        [OP_GOTO] = "goto", [OP_IF_GOTO] = "if-goto", [OP_FUNCTION] = "function",
+        [OP_CALL] = "call", [OP_RETURN]  = "return",  [OP_NATIVE]   = "native",
+        [OP_HALT] = "halt",
+    };
+
+    unsigned long *counts, steps, best;
+    int prev = OP_HALT, op, i, j, top;
+
+    counts = (unsigned long *)calloc(NUM_OPCODES * NUM_OPCODES, sizeof(unsigned long));
+
+    for (steps = 0; steps < maxSteps; steps++) {
+        op = machine->code[machine->entry].op;
+        if (op == OP_HALT) break;
+
+        machine->run(machine, 1);
+        counts[prev * NUM_OPCODES + op]++;
+        prev = op;
+    }
+
+    fprintf(stderr, "top command pairs of %lu steps:\n", steps);
+    for (i = 0; i < NUM_PROFILE_PAIRS; i++) {
+        top = 0;
+        for (j = 1; j < NUM_OPCODES * NUM_OPCODES; j++)
+            if (counts[j] > counts[top]) top = j;
+        if ((best = counts[top]) == 0) break;
+
+        fprintf(stderr, "%12lu %5.1f%%  %s; %s\n", best, 100.0 * best / steps,
+                names[top / NUM_OPCODES], names[top % NUM_OPCODES]);
+        counts[top] = 0;
+    }
+
+    free(counts);
+
+    return steps;
+}
@@ -7,68 +7,103 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
-#include <dirent.h>
-#include <libgen.h>
+#include <unistd.h>
 
-#include "parser.h"
 #include "code_writer.h"
+#include "translator.h"
+#include "translation_cache.h"
+#include "file_list.h"
+#include "emit_stats.h"
 
-struct filename {
-    char *fullname;
-    char *basename;
-    char *extension;
-};
-
-struct filename_list {
-    struct filename *filenames;
-    size_t size;
-};
+#define DEFAULT_ENTRY "Sys.init"
 
 static bool isDir(const char *path);
-
-static void initFilenameList(struct filename_list *list, size_t size);
-static void insertFileNameList(struct filename_list *list, const char *filename);
-static void delFileNameList(struct filename_list *list);
-static int countDirectoryEntry(char *filename);
+static void usage(const char *name);
 
 int main(int argc, char **argv)
 {
-    Parser parser = newParser();
     CodeWriter code_writer = newCodeWriter();
-    DIR *dirp; struct dirent *dp; struct filename_list filename_list;
-    char *fullpath, *buf1, *buf2, *base, *dot;
-    int i;
+    Translator translator = newTranslator();
+    TranslationCache cache = newTranslationCache();
+    FileList file_list = newFileList();
+    EmitStats stats = newEmitStats();
+    char *buf1, *buf2, *base, *dot;
+    int i, opt, stats_top = 0;
+    bool inline_calls = false, fuse = false, lower_math = false;
+    enum bootstrapMode bootstrap = BOOTSTRAP_CALL;
+    char *cache_dir = NULL, *entry = DEFAULT_ENTRY;
+
+    while ((opt = getopt(argc, argv, "ifmc:b:e:s:")) != -1) {
+        switch (opt) {
+            case 'i':
+                inline_calls = true;
+                break;
+            case 'f':
+                fuse = true;
+                break;
+            case 'm':
+                lower_math = true;
+                break;
+            case 'c':
+                cache_dir = optarg;
+                break;
+            case 'b':
+                if (!strcmp(optarg, "call")) {
+                    bootstrap = BOOTSTRAP_CALL;
+                } else if (!strcmp(optarg, "jump")) {
+                    bootstrap = BOOTSTRAP_JUMP;
+                } else if (!strcmp(optarg, "none")) {
+                    bootstrap = BOOTSTRAP_NONE;
+                } else {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'e':
+                entry = optarg;
+                break;
+            case 's':
+                stats_top = atoi(optarg);
+                if (stats_top < 1) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
 
-    if (argc != 2) {
+    if (argc < 2) {
         printf("Error: argument is invalid\n");
         return 1;
     }
 
-    // get filename list
-    if (isDir(argv[1])) {
-        initFilenameList(&filename_list, countDirectoryEntry(argv[1]));
+    // every file and directory on the command line goes into one program
+    file_list.init(&file_list, "vm");
+    for (i = 1; i < argc; i++)
+        file_list.add(&file_list, argv[i]);
 
-        dirp = opendir(argv[1]);
-        if (dirp == NULL) {
-            fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
-            exit errno;
-        }
+    if (file_list.num_files == 0) {
+        printf("Error: no .vm files in %s\n", argv[1]);
+        return 1;
+    }
 
-        while ((dp = readdir(dirp)) != NULL) {
-            fullpath = (char *)malloc(sizeof(char) * (strlen(argv[1]) + strlen(dp->d_name) + 2));
-            strcpy(fullpath, argv[1]);
-            strcat(fullpath, "/");
-            strcat(fullpath, dp->d_name);
-            insertFileNameList(&filename_list, fullpath);
-            free(fullpath);
-        }
-        closedir(dirp);
-    } else {
-        initFilenameList(&filename_list, 1);
-        insertFileNameList(&filename_list, argv[1]);
+    // statics are named after the file, so two files with one name would
+    // share them
+    if (!file_list.checkNames(&file_list)) {
+        file_list.del(&file_list);
+        return 1;
     }
 
-    // set output filename to code writer module
+    translator.init(&translator);
+    for (i = 0; i < file_list.num_files; i++)
+        translator.addFile(&translator, file_list.filenames[i].basename, file_list.filenames[i].fullname);
+
+    // set output filename to code writer module, named after the first source
     buf1 = (char *)malloc(sizeof(char) * strlen(argv[1]) + 1);
     strcpy(buf1, argv[1]);
     base = strrchr(buf1, '/');
@@ -76,70 +111,66 @@ int main(int argc, char **argv)
     else base += 1;
 
     if (!isDir(argv[1])) {
-        dot = strrchr(buf1, '.');
-        *dot = '\0';
+        dot = strrchr(base, '.');
+        if (dot != NULL) *dot = '\0';
     }
     buf2 = (char *)malloc(sizeof(char) * strlen(base) + strlen(".asm") + 1);
     strcpy(buf2, base);
     strcat(buf2, ".asm");
     code_writer.init(&code_writer, buf2);
-    code_writer.writeInit(&code_writer);
     free(buf1);
-    free(buf2);
 
-    for (i = 0; (size_t)i < filename_list.size; i++) {
-        if (filename_list.filenames[i].fullname == NULL) break;
-        if (strcmp(filename_list.filenames[i].extension, "vm")) continue;
-        parser.init(&parser, filename_list.filenames[i].fullname);
-
-        code_writer.setFileName(&code_writer, filename_list.filenames[i].basename);
-
-        while (parser.hasMoreCommands(&parser)) {
-            parser.advance(&parser);
-
-            switch(parser.commandType(&parser)) {
-                case C_ARITHMETRIC:
-                    code_writer.writeArithmetric(&code_writer, parser.arg1(&parser));
-                    break;
-                case C_PUSH:
-                    code_writer.writePushPop(&code_writer, C_PUSH, parser.arg1(&parser), parser.arg2(&parser));
-                    break;
-                case C_POP:
-                    code_writer.writePushPop(&code_writer, C_POP, parser.arg1(&parser), parser.arg2(&parser));
-                    break;
-                case C_LABEL:
-                    code_writer.writeLabel(&code_writer, parser.arg1(&parser));
-                    break;
-                case C_GOTO:
-                    code_writer.writeGoto(&code_writer, parser.arg1(&parser));
-                    break;
-                case C_IF:
-                    code_writer.writeIf(&code_writer, parser.arg1(&parser));
-                    break;
-                case C_FUNCTION:
-                    code_writer.writeFunction(&code_writer, parser.arg1(&parser), parser.arg2(&parser));
-                    break;
-                case C_RETURN:
-                    code_writer.writeReturn(&code_writer);
-                    break;
-                case C_CALL:
-                    code_writer.writeCall(&code_writer, parser.arg1(&parser), parser.arg2(&parser));
-                    break;
-                default:
-                    break;
-            }
-        }
-        parser.del(&parser);
+    translator.inline_calls = inline_calls;
+    translator.fuse = fuse;
+    translator.lower_math = lower_math;
+    if (stats_top > 0) {
+        stats.init(&stats);
+        translator.stats = &stats;
+    }
+    if (cache_dir != NULL) {
+        cache.init(&cache, cache_dir);
+        translator.cache = &cache;
+    }
+    if (!translator.translate(&translator, &code_writer, bootstrap, entry)) {
+        code_writer.close(&code_writer);
+        unlink(buf2);
+        free(buf2);
+        if (stats_top > 0) stats.del(&stats);
+        if (cache_dir != NULL) cache.del(&cache);
+        translator.del(&translator);
+        file_list.del(&file_list);
+        code_writer.del(&code_writer);
+        return 1;
     }
+    free(buf2);
 
     code_writer.close(&code_writer);
 
-    delFileNameList(&filename_list);
+    if (inline_calls)
+        translator.inliner.report(&translator.inliner, stderr);
+
+    if (stats_top > 0) {
+        stats.report(&stats, stderr, stats_top);
+        stats.del(&stats);
+    }
+
+    if (cache_dir != NULL) {
+        fprintf(stderr, "cache: %d of %d files reused\n", translator.num_cached, translator.num_units);
+        cache.del(&cache);
+    }
+
+    translator.del(&translator);
+    file_list.del(&file_list);
     code_writer.del(&code_writer);
 
     return 0;
 }
 
+static void usage(const char *name)
+{
+    printf("Usage: %s [-i] [-f] [-m] [-c cachedir] [-b call|jump|none] [-e entry] [-s top] source...\n", name);
+}
+
 static bool isDir(const char *path)
 {
     struct stat s;
@@ -157,91 +188,3 @@ static bool isDir(const char *path)
     else
         return false;
 }
-
-static void initFilenameList(struct filename_list *list, size_t size)
-{
-    if (list == NULL) return;
-
-    list->filenames = (struct filename *)malloc(sizeof(struct filename) * size);
-    if (list->filenames == NULL) return;
-    memset(list->filenames, (int)NULL, sizeof(struct filename) * size);
-    list->size      = size;
-
-    return;
-}
-
-static void insertFileNameList(struct filename_list *list, const char *filename)
-{
-    struct filename *filenames = list->filenames;
-    char *buf, *dot, *bname;
-
-    if (list == NULL) return;
-
-    while ((filenames->fullname) !=  NULL)
-        filenames++;
-
-    buf = (char *)malloc(sizeof(char) * strlen(filename) + 1);
-    if (buf == NULL) return;
-    strcpy(buf, filename);
-
-    filenames->fullname = (char *)malloc(sizeof(char) * strlen(buf) + 1);
-    if (filenames->fullname == NULL) return;
-    strcpy(filenames->fullname, buf);
-
-    dot = strrchr(buf, '.');
-
-    bname = basename(buf);
-
-    if (bname == NULL) {
-        filenames->basename  = NULL;
-        filenames->extension = NULL;
-    } else {
-        dot = strrchr(bname, '.');
-        *dot = '\0';
-        filenames->basename  = (char *)malloc(sizeof(char) * strlen(bname) + 1);
-        strcpy(filenames->basename, bname);
-
-        filenames->extension = (char *)malloc(sizeof(char) * strlen(dot + 1) + 1);
-        if ((filenames->basename == NULL) || (filenames->extension == NULL)) return;
-        strcpy(filenames->extension, dot + 1);
-    }
-
-    free(buf);
-    return;
-}
-
-static void delFileNameList(struct filename_list *list)
-{
-    size_t i;
-    for (i = 0; i < list->size; i++) {
-        free(list->filenames[i].extension);
-        free(list->filenames[i].basename);
-        free(list->filenames[i].fullname);
-    }
-
-    free(list->filenames);
-    list->size = 0;
-
-    return;
-}
-
-static int countDirectoryEntry(char *filename)
-{
-    DIR *dirp;
-    struct dirent *dp;
-    int count = 0;
-
-    dirp = opendir(filename);
-    if (dirp == NULL) {
-        fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
-        return 0;
-    }
-
-    while ((dp = readdir(dirp)) != NULL) {
-        count++;
-    }
-
-    closedir(dirp);
-
-    return count;
-}
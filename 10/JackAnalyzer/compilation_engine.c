@@ -28,13 +28,7 @@ void _compilation_engine_init(CompilationEngine *pThis, char *istream, char *ost
     JackTokenizer *p_tokenizer = &(pThis->tokenizer);
 
     p_tokenizer->init(p_tokenizer, istream);
-
-    pThis->fp = fopen(ostream, "w");
-
-    if (pThis->fp == NULL) {
-        fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
-        exit errno;
-    }
+    pThis->xml.init(&pThis->xml, ostream);
 }
 
 
@@ -43,7 +37,7 @@ void _compilation_engine_compileClass(CompilationEngine *pThis)
 {
     JackTokenizer *p_tokenizer = &(pThis->tokenizer);
 
-    fprintf(pThis->fp, "<class>\n");
+    pThis->xml.openTag(&pThis->xml, XML_CLASS);
 
     // 'class'
     if (!write_keyword(pThis, CLASS)) return;
@@ -69,14 +63,14 @@ void _compilation_engine_compileClass(CompilationEngine *pThis)
 
     if (!write_symbol(pThis, "}")) return;
 
-    fprintf(pThis->fp, "</class>\n");
+    pThis->xml.closeTag(&pThis->xml, XML_CLASS);
 }
 
 void _compilation_engine_compileClassVarDec(CompilationEngine *pThis)
 {
     JackTokenizer *p_tokenizer = &(pThis->tokenizer);
 
-    fprintf(pThis->fp, "<classVarDec>\n");
+    pThis->xml.openTag(&pThis->xml, XML_CLASS_VAR_DEC);
 
     // ('static' | 'field')
     switch (p_tokenizer->keyWord(p_tokenizer)) {
@@ -121,14 +115,14 @@ void _compilation_engine_compileClassVarDec(CompilationEngine *pThis)
     // ';'
     if (!write_symbol(pThis, ";")) return;
 
-    fprintf(pThis->fp, "</classVarDec>\n");
+    pThis->xml.closeTag(&pThis->xml, XML_CLASS_VAR_DEC);
 }
 
 void _compilation_engine_compileSubroutine(CompilationEngine *pThis)
 {
     JackTokenizer *p_tokenizer = &(pThis->tokenizer);
 
-    fprintf(pThis->fp, "<subroutineDec>\n");
+    pThis->xml.openTag(&pThis->xml, XML_SUBROUTINE_DEC);
 
     // ('constructor' | 'function' | 'method')
     switch (p_tokenizer->keyWord(p_tokenizer)) {
@@ -179,7 +173,7 @@ void _compilation_engine_compileSubroutine(CompilationEngine *pThis)
     if (!write_symbol(pThis, ")")) return;
 
     // subroutineBody
-    fprintf(pThis->fp, "<subroutineBody>\n");
+    pThis->xml.openTag(&pThis->xml, XML_SUBROUTINE_BODY);
 
     // "{"
     if (!write_symbol(pThis, "{")) return;
@@ -194,9 +188,9 @@ void _compilation_engine_compileSubroutine(CompilationEngine *pThis)
     // "}"
     if (!write_symbol(pThis, "}")) return;
 
-    fprintf(pThis->fp, "</subroutineBody>\n");
+    pThis->xml.closeTag(&pThis->xml, XML_SUBROUTINE_BODY);
 
-    fprintf(pThis->fp, "</subroutineDec>\n");
+    pThis->xml.closeTag(&pThis->xml, XML_SUBROUTINE_DEC);
 }
 
 void _compilation_engine_compileParameterlist(CompilationEngine *pThis)
@@ -204,7 +198,7 @@ void _compilation_engine_compileParameterlist(CompilationEngine *pThis)
     JackTokenizer *p_tokenizer = &(pThis->tokenizer);
     int i;
 
-    fprintf(pThis->fp, "<parameterList>\n");
+    pThis->xml.openTag(&pThis->xml, XML_PARAMETER_LIST);
 
     for (i = 0; (i < 2) && (is_type(p_tokenizer)); i++) {
         // type
@@ -256,7 +250,7 @@ void _compilation_engine_compileParameterlist(CompilationEngine *pThis)
         }
     };
 
-    fprintf(pThis->fp, "</parameterList>\n");
+    pThis->xml.closeTag(&pThis->xml, XML_PARAMETER_LIST);
 
     return;
 
@@ -266,7 +260,7 @@ void _compilation_engine_compileVarDec(CompilationEngine *pThis)
 {
     JackTokenizer *p_tokenizer = &(pThis->tokenizer);
 
-    fprintf(pThis->fp, "<varDec>\n");
+    pThis->xml.openTag(&pThis->xml, XML_VAR_DEC);
 
     // 'var'
     if (!write_keyword(pThis, VAR)) return;
@@ -302,14 +296,14 @@ void _compilation_engine_compileVarDec(CompilationEngine *pThis)
     // ';'
     if (!write_symbol(pThis, ";")) return;
 
-    fprintf(pThis->fp, "</varDec>\n");
+    pThis->xml.closeTag(&pThis->xml, XML_VAR_DEC);
 }
 
 void _compilation_engine_compileStatements(CompilationEngine *pThis)
 {
     JackTokenizer *p_tokenizer = &(pThis->tokenizer);
 
-    fprintf(pThis->fp, "<statements>\n");
+    pThis->xml.openTag(&pThis->xml, XML_STATEMENTS);
 
     while (p_tokenizer->tokenType(p_tokenizer) == KEYWORD
             && (p_tokenizer->keyWord(p_tokenizer) == LET
@@ -339,13 +333,13 @@ void _compilation_engine_compileStatements(CompilationEngine *pThis)
         }
     }
 
-    fprintf(pThis->fp, "</statements>\n");
+    pThis->xml.closeTag(&pThis->xml, XML_STATEMENTS);
 }
 
 void _compilation_engine_compileDo(CompilationEngine *pThis)
 {
     JackTokenizer *p_tokenizer = &(pThis->tokenizer);
-    fprintf(pThis->fp, "<doStatement>\n");
+    pThis->xml.openTag(&pThis->xml, XML_DO_STATEMENT);
 
     // 'do'
     if (!write_keyword(pThis, DO)) return;
@@ -386,7 +380,7 @@ void _compilation_engine_compileDo(CompilationEngine *pThis)
     // ';'
     if (!write_symbol(pThis, ";")) return;
 
-    fprintf(pThis->fp, "</doStatement>\n");
+    pThis->xml.closeTag(&pThis->xml, XML_DO_STATEMENT);
 }
 
 void _compilation_engine_compileLet(CompilationEngine *pThis)
@@ -394,7 +388,7 @@ void _compilation_engine_compileLet(CompilationEngine *pThis)
     JackTokenizer *p_tokenizer = &(pThis->tokenizer);
     int i;
 
-    fprintf(pThis->fp, "<letStatement>\n");
+    pThis->xml.openTag(&pThis->xml, XML_LET_STATEMENT);
 
     // 'let'
     if (!write_keyword(pThis, LET)) return;
@@ -418,13 +412,13 @@ void _compilation_engine_compileLet(CompilationEngine *pThis)
     // ';'
     if (!write_symbol(pThis, ";")) return;
 
-    fprintf(pThis->fp, "</letStatement>\n");
+    pThis->xml.closeTag(&pThis->xml, XML_LET_STATEMENT);
 }
 
 
 void _compilation_engine_compileWhile(CompilationEngine *pThis)
 {
-    fprintf(pThis->fp, "<whileStatement>\n");
+    pThis->xml.openTag(&pThis->xml, XML_WHILE_STATEMENT);
 
     // 'while'
     if (!write_keyword(pThis, WHILE)) return;
@@ -446,7 +440,7 @@ void _compilation_engine_compileWhile(CompilationEngine *pThis)
 
     // '}'
     if (!write_symbol(pThis, "}")) return;
-    fprintf(pThis->fp, "</whileStatement>\n");
+    pThis->xml.closeTag(&pThis->xml, XML_WHILE_STATEMENT);
 }
 
 void _compilation_engine_compileReturn(CompilationEngine *pThis)
@@ -454,7 +448,7 @@ void _compilation_engine_compileReturn(CompilationEngine *pThis)
     JackTokenizer *p_tokenizer = &(pThis->tokenizer);
     int i;
 
-    fprintf(pThis->fp, "<returnStatement>\n");
+    pThis->xml.openTag(&pThis->xml, XML_RETURN_STATEMENT);
 
     // 'return'
     if (!write_keyword(pThis, RETURN)) return;
@@ -466,7 +460,7 @@ void _compilation_engine_compileReturn(CompilationEngine *pThis)
     // ';'
     if (!write_symbol(pThis, ";")) return;
 
-    fprintf(pThis->fp, "</returnStatement>\n");
+    pThis->xml.closeTag(&pThis->xml, XML_RETURN_STATEMENT);
 }
 
 void _compilation_engine_compileIf(CompilationEngine *pThis)
@@ -474,7 +468,7 @@ void _compilation_engine_compileIf(CompilationEngine *pThis)
     JackTokenizer *p_tokenizer = &(pThis->tokenizer);
     int i;
 
-    fprintf(pThis->fp, "<ifStatement>\n");
+    pThis->xml.openTag(&pThis->xml, XML_IF_STATEMENT);
 
     // 'if'
     if (!write_keyword(pThis, IF)) return;
@@ -511,14 +505,14 @@ void _compilation_engine_compileIf(CompilationEngine *pThis)
         if (!write_symbol(pThis, "}")) return;
     }
 
-    fprintf(pThis->fp, "</ifStatement>\n");
+    pThis->xml.closeTag(&pThis->xml, XML_IF_STATEMENT);
 }
 
 void _compilation_engine_compileExpression(CompilationEngine *pThis)
 {
     JackTokenizer *p_tokenizer = &(pThis->tokenizer);
 
-    fprintf(pThis->fp, "<expression>\n");
+    pThis->xml.openTag(&pThis->xml, XML_EXPRESSION);
 
     // term
     pThis->compileTerm(pThis);
@@ -530,14 +524,14 @@ void _compilation_engine_compileExpression(CompilationEngine *pThis)
         pThis->compileTerm(pThis);
     }
 
-    fprintf(pThis->fp, "</expression>\n");
+    pThis->xml.closeTag(&pThis->xml, XML_EXPRESSION);
 }
 
 void _compilation_engine_compileTerm(CompilationEngine *pThis)
 {
     JackTokenizer *p_tokenizer = &(pThis->tokenizer);
 
-    fprintf(pThis->fp, "<term>\n");
+    pThis->xml.openTag(&pThis->xml, XML_TERM);
 
     switch (p_tokenizer->tokenType(p_tokenizer)) {
         case INT_CONST:
@@ -627,7 +621,7 @@ void _compilation_engine_compileTerm(CompilationEngine *pThis)
             break;
     }
 
-    fprintf(pThis->fp, "</term>\n");
+    pThis->xml.closeTag(&pThis->xml, XML_TERM);
 }
 
 void _compilation_engine_compileExpressionList(CompilationEngine *pThis)
@@ -635,7 +629,7 @@ void _compilation_engine_compileExpressionList(CompilationEngine *pThis)
     JackTokenizer *p_tokenizer = &(pThis->tokenizer);
     int i;
 
-    fprintf(pThis->fp, "<expressionList>\n");
+    pThis->xml.openTag(&pThis->xml, XML_EXPRESSION_LIST);
 
     for (i = 0; (i < 2) && (is_begin_of_expression(p_tokenizer)); i++) {
         // expression
@@ -650,7 +644,7 @@ void _compilation_engine_compileExpressionList(CompilationEngine *pThis)
         }
     };
 
-    fprintf(pThis->fp, "</expressionList>\n");
+    pThis->xml.closeTag(&pThis->xml, XML_EXPRESSION_LIST);
 
     return;
 }
@@ -661,7 +655,7 @@ void _compilation_engine_del(CompilationEngine *pThis)
 
     p_tokenizer->del(p_tokenizer);
 
-    fclose(pThis->fp); 
+    pThis->xml.del(&pThis->xml);
     return;
 }
 
@@ -679,8 +673,7 @@ static bool write_keyword(CompilationEngine *pThis, enum KeyWord keyword)
         TOKEN_ERR(str[keyword]);
         return false;
     }
-    // fprintf(pThis->fp, "<keyword> %s </keyword>\n", str[keyword]);
-    p_tokenizer->printCurrentToken(p_tokenizer, pThis->fp);
+    pThis->xml.writeToken(&pThis->xml, p_tokenizer);
 
     if (p_tokenizer->hasMoreTokens(p_tokenizer))
         p_tokenizer->advance(p_tokenizer);
@@ -697,8 +690,7 @@ static bool write_symbol(CompilationEngine *pThis, char *symbol)
         TOKEN_ERR(symbol);
         return false;
     }
-    // fprintf(pThis->fp, "<symbol> %s </symbol>\n", p_tokenizer->symbol(p_tokenizer));
-    p_tokenizer->printCurrentToken(p_tokenizer, pThis->fp);
+    pThis->xml.writeToken(&pThis->xml, p_tokenizer);
 
     if (p_tokenizer->hasMoreTokens(p_tokenizer))
         p_tokenizer->advance(p_tokenizer);
@@ -714,8 +706,7 @@ static bool write_integerConstant(CompilationEngine *pThis)
         TOKEN_ERR("integerConstant");
         return false;
     }
-    // fprintf(pThis->fp, "<integerConstant> %d </integerConstant>\n", p_tokenizer->intVal(p_tokenizer));
-    p_tokenizer->printCurrentToken(p_tokenizer, pThis->fp);
+    pThis->xml.writeToken(&pThis->xml, p_tokenizer);
 
     if (p_tokenizer->hasMoreTokens(p_tokenizer))
         p_tokenizer->advance(p_tokenizer);
@@ -731,8 +722,7 @@ static bool write_stringConstant(CompilationEngine *pThis)
         TOKEN_ERR("stringConstant");
         return false;
     }
-    // fprintf(pThis->fp, "<stringConstant> %s </stringConstant>\n", p_tokenizer->stringVal(p_tokenizer));
-    p_tokenizer->printCurrentToken(p_tokenizer, pThis->fp);
+    pThis->xml.writeToken(&pThis->xml, p_tokenizer);
 
     if (p_tokenizer->hasMoreTokens(p_tokenizer))
         p_tokenizer->advance(p_tokenizer);
@@ -748,8 +738,7 @@ static bool write_identifier(CompilationEngine *pThis)
         TOKEN_ERR("identifier");
         return false;
     }
-    // fprintf(pThis->fp, "<identifier> %s </identifier>\n", p_tokenizer->identifier(p_tokenizer));
-    p_tokenizer->printCurrentToken(p_tokenizer, pThis->fp);
+    pThis->xml.writeToken(&pThis->xml, p_tokenizer);
 
     if (p_tokenizer->hasMoreTokens(p_tokenizer))
         p_tokenizer->advance(p_tokenizer);
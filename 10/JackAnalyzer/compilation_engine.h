@@ -6,12 +6,13 @@
 #define _COMPILATION_ENGINE_H_
 
 #include "jack_tokenizer.h"
+#include "xml_writer.h"
 #include <stdio.h>
 
 
 typedef struct compilation_engine {
     JackTokenizer tokenizer;
-    FILE *fp;
+    XMLWriter xml;
 
     void (*init)(struct compilation_engine *, char *, char *);
     void (*compileClass)(struct compilation_engine *);
@@ -52,7 +53,7 @@ extern void _compilation_engine_del(CompilationEngine *pThis);
 
 #define newCompilationEngine() {                                            \
     .tokenizer              = newJackTokenizer(),                           \
-    .fp                     = NULL,                                         \
+    .xml                    = newXMLWriter(),                               \
     .init                   = _compilation_engine_init,                     \
     .compileClass           = _compilation_engine_compileClass,             \
     .compileClassVarDec     = _compilation_engine_compileClassVarDec,       \
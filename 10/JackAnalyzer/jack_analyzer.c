@@ -35,10 +35,10 @@ int main(int argc, char **argv)
 {
     CompilationEngine engine = newCompilationEngine();
     JackTokenizer tokenizer = newJackTokenizer();
+    XMLWriter xml = newXMLWriter();
     DIR *dirp; struct dirent *dp; struct filename_list filename_list;
     char *fullpath, *buf1, *buf2, *base, *dot;
     int i;
-    FILE *fp;
 
     if (argc != 2) {
         printf("Error: argument is invalid\n");
@@ -99,12 +99,13 @@ int main(int argc, char **argv)
         engine.init(&engine, filename_list.filenames[i].fullname, buf1);
         tokenizer.init(&tokenizer, filename_list.filenames[i].fullname);
 
-        fp = fopen(buf2, "w");
+        xml.init(&xml, buf2);
         while(tokenizer.hasMoreTokens(&tokenizer)) {
             tokenizer.advance(&tokenizer);
-            tokenizer.printCurrentToken(&tokenizer, fp);
+            xml.writeToken(&xml, &tokenizer);
         }
-        fclose(fp);
+        xml.del(&xml);
+        tokenizer.del(&tokenizer);
 
         if (engine.tokenizer.hasMoreTokens(&engine.tokenizer))
             engine.tokenizer.advance(&engine.tokenizer);
@@ -25,8 +25,6 @@ static bool isConstantInt(char *str);
 static bool isConstantStr(char *str);
 static bool isIdentifier(char *str);
 static struct token getTokenInfo(char *str);
-static void printToken(struct token token, FILE *fp);
-static char *formatXML(const char *in, char *out);
 
 void _jack_tokenizer_init(JackTokenizer *pThis, char *name)
 {
@@ -187,11 +185,6 @@ char *_jack_tokenizer_stringVal(JackTokenizer *pThis)
     return pThis->token.data.str_const;
 }
 
-void _jack_tokenizer_print_cur_token(JackTokenizer *pThis, FILE *fp)
-{
-    printToken(pThis->token, fp);
-}
-
 void _jack_tokenizer_del(JackTokenizer *pThis)
 {
     fclose(pThis->fp);
@@ -300,45 +293,3 @@ static struct token getTokenInfo(char *str)
 
     return token;
 }
-
-static void printToken(struct token token, FILE *fp)
-{
-    char buf[256] = {0};
-
-    switch (token.type) {
-        case KEYWORD:
-            fprintf(fp, "<keyword> %s </keyword>\n", keyword[token.data.keyword]);
-            break;
-        case SYMBOL:
-            fprintf(fp, "<symbol> %s </symbol>\n", formatXML(token.data.symbol, buf));
-            break;
-        case INT_CONST:
-            fprintf(fp, "<integerConstant> %d </integerConstant>\n", token.data.int_const);
-            break;
-        case STRING_CONST:
-            fprintf(fp, "<stringConstant> %s </stringConstant>\n", token.data.str_const);
-            break;
-        case INDENTIFIER:
-            fprintf(fp, "<identifier> %s </identifier>\n", token.data.identifier);
-            break;
-        default:
-            break;
-    }
-}
-
-
-static char *formatXML(const char *in, char *out)
-{
-    if (!strcmp(in, "<")) {
-        strcpy(out, "&lt;");
-    } else if (!strcmp(in, ">")) {
-        strcpy(out, "&gt;");
-    } else if (!strcmp(in, "&")) {
-        strcpy(out, "&amp;");
-    } else {
-        strcpy(out, in);
-    }
-
-    return out;
-
-}
@@ -36,7 +36,6 @@ typedef struct jack_tokenizer {
     char *(*identifier)(struct jack_tokenizer *);
     int  (*intVal)(struct jack_tokenizer *);
     char *(*stringVal)(struct jack_tokenizer *);
-    void (*printCurrentToken)(struct jack_tokenizer *, FILE *fp);
     void (*del)(struct jack_tokenizer *);
 } JackTokenizer;
 
@@ -50,7 +49,6 @@ extern char *_jack_tokenizer_identifier(JackTokenizer *pThis);
 extern int  _jack_tokenizer_intVal(JackTokenizer *pThis);
 extern char *_jack_tokenizer_stringVal(JackTokenizer *pThis);
 extern void _jack_tokenizer_del(JackTokenizer *pThis);
-extern void _jack_tokenizer_print_cur_token(JackTokenizer *pThis, FILE *fp);
 
 #define newJackTokenizer() {       \
     .init              = _jack_tokenizer_init,              \
@@ -62,7 +60,6 @@ extern void _jack_tokenizer_print_cur_token(JackTokenizer *pThis, FILE *fp);
     .identifier        = _jack_tokenizer_identifier,        \
     .intVal            = _jack_tokenizer_intVal,            \
     .stringVal         = _jack_tokenizer_stringVal,         \
-    .printCurrentToken = _jack_tokenizer_print_cur_token,   \
     .del               = _jack_tokenizer_del                \
 }
 
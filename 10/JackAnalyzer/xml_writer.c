@@ -0,0 +1,226 @@
+/*
+ * xml_writer.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "xml_writer.h"
+
+#define XML_BUFFER_SIZE (64 * 1024)
+#define XML_LINE_MAX    64          // a line without its token text fits in this
+
+struct tag {
+    const char *text;
+    size_t len;
+};
+
+#define TAG(s) {s, sizeof(s) - 1}
+
+static const struct tag open_tag[MAX_NONTERMINAL] = {
+    TAG("<class>\n"),           TAG("<classVarDec>\n"),     TAG("<subroutineDec>\n"),
+    TAG("<parameterList>\n"),   TAG("<subroutineBody>\n"),  TAG("<varDec>\n"),
+    TAG("<statements>\n"),      TAG("<letStatement>\n"),    TAG("<ifStatement>\n"),
+    TAG("<whileStatement>\n"),  TAG("<doStatement>\n"),     TAG("<returnStatement>\n"),
+    TAG("<expression>\n"),      TAG("<term>\n"),            TAG("<expressionList>\n"),
+};
+
+static const struct tag close_tag[MAX_NONTERMINAL] = {
+    TAG("</class>\n"),          TAG("</classVarDec>\n"),    TAG("</subroutineDec>\n"),
+    TAG("</parameterList>\n"),  TAG("</subroutineBody>\n"), TAG("</varDec>\n"),
+    TAG("</statements>\n"),     TAG("</letStatement>\n"),   TAG("</ifStatement>\n"),
+    TAG("</whileStatement>\n"), TAG("</doStatement>\n"),    TAG("</returnStatement>\n"),
+    TAG("</expression>\n"),     TAG("</term>\n"),           TAG("</expressionList>\n"),
+};
+
+// a keyword token is written as one whole line
+#define KEYWORD_LINE(s) TAG("<keyword> " s " </keyword>\n")
+
+static const struct tag keyword_line[MAX_KEYWORD] = {
+    KEYWORD_LINE("class"),   KEYWORD_LINE("method"),  KEYWORD_LINE("function"),
+    KEYWORD_LINE("constructor"), KEYWORD_LINE("int"), KEYWORD_LINE("boolean"),
+    KEYWORD_LINE("char"),    KEYWORD_LINE("void"),    KEYWORD_LINE("var"),
+    KEYWORD_LINE("static"),  KEYWORD_LINE("field"),   KEYWORD_LINE("let"),
+    KEYWORD_LINE("do"),      KEYWORD_LINE("if"),      KEYWORD_LINE("else"),
+    KEYWORD_LINE("while"),   KEYWORD_LINE("return"),  KEYWORD_LINE("true"),
+    KEYWORD_LINE("false"),   KEYWORD_LINE("null"),    KEYWORD_LINE("this"),
+};
+
+// the tags around the text of the other token types
+static const struct tag token_open[MAX_TOKEN_TYPE] = {
+    [SYMBOL]       = TAG("<symbol> "),
+    [INDENTIFIER]  = TAG("<identifier> "),
+    [INT_CONST]    = TAG("<integerConstant> "),
+    [STRING_CONST] = TAG("<stringConstant> "),
+};
+
+static const struct tag token_close[MAX_TOKEN_TYPE] = {
+    [SYMBOL]       = TAG(" </symbol>\n"),
+    [INDENTIFIER]  = TAG(" </identifier>\n"),
+    [INT_CONST]    = TAG(" </integerConstant>\n"),
+    [STRING_CONST] = TAG(" </stringConstant>\n"),
+};
+
+static void reserve(XMLWriter *pThis, size_t len);
+static void append(XMLWriter *pThis, const struct tag *tag);
+static void append_escaped(XMLWriter *pThis, const char *text);
+static void append_int(XMLWriter *pThis, int value);
+static void flush(XMLWriter *pThis);
+
+void _xml_writer_init(XMLWriter *pThis, char *name)
+{
+    pThis->fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+    if (pThis->fd == -1) {
+        fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
+        exit errno;
+    }
+
+    pThis->buf = (char *)malloc(sizeof(char) * XML_BUFFER_SIZE);
+    pThis->len = 0;
+
+    return;
+}
+
+void _xml_writer_openTag(XMLWriter *pThis, enum nonterminal tag)
+{
+    reserve(pThis, open_tag[tag].len);
+    append(pThis, &open_tag[tag]);
+}
+
+void _xml_writer_closeTag(XMLWriter *pThis, enum nonterminal tag)
+{
+    reserve(pThis, close_tag[tag].len);
+    append(pThis, &close_tag[tag]);
+}
+
+// the current token as one line; nothing is written for an unknown token
+void _xml_writer_writeToken(XMLWriter *pThis, JackTokenizer *tokenizer)
+{
+    enum TokenType type = tokenizer->tokenType(tokenizer);
+    enum KeyWord keyword;
+
+    switch (type) {
+        case KEYWORD:
+            keyword = tokenizer->keyWord(tokenizer);
+            if (keyword >= MAX_KEYWORD) return;
+            reserve(pThis, keyword_line[keyword].len);
+            append(pThis, &keyword_line[keyword]);
+            return;
+
+        case SYMBOL:
+        case INDENTIFIER:
+        case INT_CONST:
+        case STRING_CONST:
+            break;
+
+        default:
+            return;
+    }
+
+    reserve(pThis, XML_LINE_MAX);
+    append(pThis, &token_open[type]);
+    switch (type) {
+        case SYMBOL:
+            append_escaped(pThis, tokenizer->symbol(tokenizer));
+            break;
+        case INDENTIFIER:
+            append_escaped(pThis, tokenizer->identifier(tokenizer));
+            break;
+        case INT_CONST:
+            append_int(pThis, tokenizer->intVal(tokenizer));
+            break;
+        default:
+            append_escaped(pThis, tokenizer->stringVal(tokenizer));
+            break;
+    }
+    reserve(pThis, token_close[type].len);
+    append(pThis, &token_close[type]);
+}
+
+void _xml_writer_del(XMLWriter *pThis)
+{
+    flush(pThis);
+    close(pThis->fd);
+    pThis->fd = -1;
+    free(pThis->buf);
+    pThis->buf = NULL;
+
+    return;
+}
+
+// room for len more bytes, flushing what is buffered if needed
+static void reserve(XMLWriter *pThis, size_t len)
+{
+    if (pThis->len + len > XML_BUFFER_SIZE)
+        flush(pThis);
+}
+
+static void append(XMLWriter *pThis, const struct tag *tag)
+{
+    memcpy(pThis->buf + pThis->len, tag->text, tag->len);
+    pThis->len += tag->len;
+}
+
+// runs without a character to escape are copied whole
+static void append_escaped(XMLWriter *pThis, const char *text)
+{
+    static const struct tag entity[] = {TAG("&lt;"), TAG("&gt;"), TAG("&amp;")};
+    const struct tag *e;
+    size_t run, n;
+
+    while (*text != '\0') {
+        for (run = strcspn(text, "<>&"); run > 0; run -= n) {
+            reserve(pThis, run < XML_LINE_MAX ? run : XML_LINE_MAX);
+            n = XML_BUFFER_SIZE - pThis->len;
+            if (n > run) n = run;
+            memcpy(pThis->buf + pThis->len, text, n);
+            pThis->len += n;
+            text += n;
+        }
+        if (*text == '\0') break;
+
+        e = &entity[*text == '<' ? 0 : *text == '>' ? 1 : 2];
+        reserve(pThis, e->len);
+        append(pThis, e);
+        text++;
+    }
+}
+
+static void append_int(XMLWriter *pThis, int value)
+{
+    char digits[16];
+    unsigned int u = value < 0 ? -(unsigned int)value : (unsigned int)value;
+    int n = 0;
+
+    do {
+        digits[n++] = '0' + u % 10;
+        u /= 10;
+    } while (u != 0);
+    if (value < 0)
+        digits[n++] = '-';
+
+    while (n > 0)
+        pThis->buf[pThis->len++] = digits[--n];
+}
+
+static void flush(XMLWriter *pThis)
+{
+    size_t done = 0;
+    ssize_t n;
+
+    while (done < pThis->len) {
+        n = write(pThis->fd, pThis->buf + done, pThis->len - done);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
+            exit errno;
+        }
+        done += n;
+    }
+    pThis->len = 0;
+}
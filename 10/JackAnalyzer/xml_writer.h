@@ -0,0 +1,61 @@
+/*
+ * xml_writer.h
+ */
+
+#ifndef _XML_WRITER_H_
+#define _XML_WRITER_H_
+
+#include <stddef.h>
+#include "jack_tokenizer.h"
+
+enum nonterminal {
+    XML_CLASS,
+    XML_CLASS_VAR_DEC,
+    XML_SUBROUTINE_DEC,
+    XML_PARAMETER_LIST,
+    XML_SUBROUTINE_BODY,
+    XML_VAR_DEC,
+    XML_STATEMENTS,
+    XML_LET_STATEMENT,
+    XML_IF_STATEMENT,
+    XML_WHILE_STATEMENT,
+    XML_DO_STATEMENT,
+    XML_RETURN_STATEMENT,
+    XML_EXPRESSION,
+    XML_TERM,
+    XML_EXPRESSION_LIST,
+    MAX_NONTERMINAL,
+};
+
+// an XML file written through one buffer; tags are copied from tables
+// built at compile time and only token text is escaped
+typedef struct xml_writer {
+    int fd;
+    char *buf;
+    size_t len;
+
+    void (*init)(struct xml_writer *, char *);
+    void (*openTag)(struct xml_writer *, enum nonterminal);
+    void (*closeTag)(struct xml_writer *, enum nonterminal);
+    void (*writeToken)(struct xml_writer *, JackTokenizer *);
+    void (*del)(struct xml_writer *);
+} XMLWriter;
+
+extern void _xml_writer_init(XMLWriter *pThis, char *name);
+extern void _xml_writer_openTag(XMLWriter *pThis, enum nonterminal tag);
+extern void _xml_writer_closeTag(XMLWriter *pThis, enum nonterminal tag);
+extern void _xml_writer_writeToken(XMLWriter *pThis, JackTokenizer *tokenizer);
+extern void _xml_writer_del(XMLWriter *pThis);
+
+#define newXMLWriter() {                        \
+    .fd         = -1,                           \
+    .buf        = NULL,                         \
+    .len        = 0,                            \
+    .init       = _xml_writer_init,             \
+    .openTag    = _xml_writer_openTag,          \
+    .closeTag   = _xml_writer_closeTag,         \
+    .writeToken = _xml_writer_writeToken,       \
+    .del        = _xml_writer_del,              \
+}
+
+#endif
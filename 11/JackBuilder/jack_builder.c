@@ -0,0 +1,233 @@
+/*
+ * jack_builder.c
+ */
+
+#include <sys/stat.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "compilation_engine.h"
+#include "file_list.h"
+#include "code_writer.h"
+#include "translator.h"
+#include "assemble.h"
+
+#define DEFAULT_ENTRY "Sys.init"
+
+// the VM commands of one class, kept until the program is translated
+struct vm_source {
+    char *buf;
+    size_t len;
+};
+
+static void usage(const char *name);
+static bool isDir(const char *path);
+static char *outputName(const char *path, const char *extension);
+static void writeFile(const char *name, const char *data, size_t len);
+
+int main(int argc, char **argv)
+{
+    FileList file_list = newFileList();
+    Translator translator = newTranslator();
+    CodeWriter code_writer = newCodeWriter();
+    struct vm_source *sources;
+    char *name;
+    FILE *fp;
+    int i, opt;
+    bool write_vm = false, write_asm = false;
+    bool inline_calls = false, fuse = false, lower_math = false;
+    enum bootstrapMode bootstrap = BOOTSTRAP_CALL;
+    char *entry = DEFAULT_ENTRY;
+
+    while ((opt = getopt(argc, argv, "ifmvab:e:")) != -1) {
+        switch (opt) {
+            case 'i':
+                inline_calls = true;
+                break;
+            case 'f':
+                fuse = true;
+                break;
+            case 'm':
+                lower_math = true;
+                break;
+            case 'v':
+                write_vm = true;
+                break;
+            case 'a':
+                write_asm = true;
+                break;
+            case 'b':
+                if (!strcmp(optarg, "call")) {
+                    bootstrap = BOOTSTRAP_CALL;
+                } else if (!strcmp(optarg, "jump")) {
+                    bootstrap = BOOTSTRAP_JUMP;
+                } else if (!strcmp(optarg, "none")) {
+                    bootstrap = BOOTSTRAP_NONE;
+                } else {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'e':
+                entry = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
+
+    if (argc < 2) {
+        printf("Error: argument is invalid\n");
+        return 1;
+    }
+
+    // every file and directory on the command line goes into one program
+    file_list.init(&file_list, "jack");
+    for (i = 1; i < argc; i++)
+        file_list.add(&file_list, argv[i]);
+
+    if (file_list.num_files == 0) {
+        printf("Error: no .jack files in %s\n", argv[1]);
+        return 1;
+    }
+
+    // a class is named after its file, so two files with one name would
+    // define the same functions and share their statics
+    if (!file_list.checkNames(&file_list)) {
+        file_list.del(&file_list);
+        return 1;
+    }
+
+    // each class is compiled into memory, as JackCompiler would write it
+    sources = (struct vm_source *)calloc(file_list.num_files, sizeof(struct vm_source));
+    translator.init(&translator);
+    for (i = 0; i < file_list.num_files; i++) {
+        CompilationEngine engine = newCompilationEngine();
+
+        engine.init(&engine, file_list.filenames[i].fullname, NULL);
+
+        if (engine.tokenizer.hasMoreTokens(&engine.tokenizer))
+            engine.tokenizer.advance(&engine.tokenizer);
+        engine.compileClass(&engine);
+        engine.del(&engine);
+
+        sources[i].buf = engine.writer.buf;
+        sources[i].len = engine.writer.len;
+        if (write_vm) {
+            name = outputName(file_list.filenames[i].basename, ".vm");
+            writeFile(name, sources[i].buf, sources[i].len);
+            free(name);
+        }
+        translator.addSource(&translator, file_list.filenames[i].basename, sources[i].buf, sources[i].len);
+    }
+
+    // the whole program is translated into one buffer
+    translator.inline_calls = inline_calls;
+    translator.fuse = fuse;
+    translator.lower_math = lower_math;
+    code_writer.initBuffer(&code_writer);
+    if (!translator.translate(&translator, &code_writer, bootstrap, entry)) {
+        code_writer.del(&code_writer);
+        translator.del(&translator);
+        for (i = 0; i < file_list.num_files; i++)
+            free(sources[i].buf);
+        free(sources);
+        file_list.del(&file_list);
+        return 1;
+    }
+    code_writer.close(&code_writer);
+
+    if (write_asm) {
+        name = outputName(argv[1], ".asm");
+        writeFile(name, code_writer.out, code_writer.out_len);
+        free(name);
+    }
+
+    // which is assembled straight from memory, named after the first source
+    name = outputName(argv[1], ".hack");
+    fp = fopen(name, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
+        exit errno;
+    }
+    assembleBuffer(code_writer.out, code_writer.out_len, fp);
+    fclose(fp);
+    free(name);
+
+    code_writer.del(&code_writer);
+    translator.del(&translator);
+    for (i = 0; i < file_list.num_files; i++)
+        free(sources[i].buf);
+    free(sources);
+    file_list.del(&file_list);
+
+    return 0;
+}
+
+static void usage(const char *name)
+{
+    printf("Usage: %s [-i] [-f] [-m] [-v] [-a] [-b call|jump|none] [-e entry] source...\n", name);
+}
+
+static bool isDir(const char *path)
+{
+    struct stat s;
+    int ret;
+
+    ret = stat(path, &s);
+
+    if (ret == -1)
+        return false;
+
+    if (S_ISDIR(s.st_mode))
+        return true;
+    else
+        return false;
+}
+
+// the last component of path, without the extension of a file, followed by
+// extension
+static char *outputName(const char *path, const char *extension)
+{
+    char *buf, *base, *dot, *name;
+
+    buf = (char *)malloc(sizeof(char) * strlen(path) + 1);
+    strcpy(buf, path);
+    while (strlen(buf) > 1 && buf[strlen(buf) - 1] == '/')
+        buf[strlen(buf) - 1] = '\0';
+
+    base = strrchr(buf, '/');
+    if (base == NULL) base = buf;
+    else base += 1;
+
+    if (!isDir(path)) {
+        dot = strrchr(base, '.');
+        if (dot != NULL) *dot = '\0';
+    }
+
+    name = (char *)malloc(sizeof(char) * (strlen(base) + strlen(extension) + 1));
+    strcpy(name, base);
+    strcat(name, extension);
+    free(buf);
+
+    return name;
+}
+
+static void writeFile(const char *name, const char *data, size_t len)
+{
+    FILE *fp;
+
+    fp = fopen(name, "w");
+    if (fp == NULL || fwrite(data, 1, len, fp) != len) {
+        fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
+        exit errno;
+    }
+    fclose(fp);
+}
@@ -25,8 +25,11 @@ void _compilation_engine_init(CompilationEngine *pThis, char *istream, char *ost
     pThis->tokenizer.init(&pThis->tokenizer, istream);
     pThis->symbols.init(&pThis->symbols);
     pThis->writer.init(&pThis->writer, ostream);
+    pThis->strings.init(&pThis->strings);
 
-    pThis->class_name = malloc(sizeof(char) * 1024);
+    pThis->class_name = NULL;
+    pThis->n_while_label = 0;
+    pThis->n_if_label = 0;
 }
 
 
@@ -48,7 +51,7 @@ void _compilation_engine_compileClass(CompilationEngine *pThis)
         TOKEN_ERR("identifier");
         exit (0);
     }
-    strcpy(pThis->class_name, p_tokenizer->current_token);
+    pThis->class_name = p_tokenizer->current_token;
     advance(p_tokenizer);
 
 
@@ -87,8 +90,6 @@ void _compilation_engine_compileClassVarDec(CompilationEngine *pThis)
     enum kind kind;
     char *type;
 
-    type = malloc(sizeof(char) * 1024);
-
     // ('static' | 'field')
     if (!(p_tokenizer->tokenType(p_tokenizer) == KEYWORD)) {
         TOKEN_ERR("keyword");
@@ -111,20 +112,20 @@ void _compilation_engine_compileClassVarDec(CompilationEngine *pThis)
     if (p_tokenizer->tokenType(p_tokenizer) == KEYWORD) {
         switch (p_tokenizer->keyWord(p_tokenizer)) {
             case INT:
-                strcpy(type, "int");
+                type = "int";
                 break;
             case CHAR:
-                strcpy(type, "char");
+                type = "char";
                 break;
             case BOOLEAN:
-                strcpy(type, "boolean");
+                type = "boolean";
                 break;
             default:
                 TOKEN_ERR("'int' or 'char' or 'boolean'");
                 exit (0);
         }
     } else if (p_tokenizer->tokenType(p_tokenizer) == INDENTIFIER) {
-        strcpy(type, p_tokenizer->current_token);
+        type = p_tokenizer->current_token;
     } else {
         TOKEN_ERR("'int' or 'char' or 'boolean' or 'identifier'");
         exit (0);
@@ -159,8 +160,6 @@ void _compilation_engine_compileClassVarDec(CompilationEngine *pThis)
         exit (0);
     }
     advance(p_tokenizer);
-
-    free(type);
 }
 
 void _compilation_engine_compileSubroutine(CompilationEngine *pThis)
@@ -169,8 +168,6 @@ void _compilation_engine_compileSubroutine(CompilationEngine *pThis)
     enum KeyWord subroutine;
     char *vm_func_name;
 
-    vm_func_name = malloc(sizeof(char) * 1024);
-
     pThis->symbols.startSubroutine(&pThis->symbols);
 
     // ('constructor' | 'function' | 'method')
@@ -214,7 +211,7 @@ void _compilation_engine_compileSubroutine(CompilationEngine *pThis)
         TOKEN_ERR("identifier");
         exit (0);
     }
-    sprintf(vm_func_name, "%s.%s", pThis->class_name, p_tokenizer->current_token);
+    vm_func_name = pThis->strings.format(&(pThis->strings), "%s.%s", pThis->class_name, p_tokenizer->current_token);
     advance(p_tokenizer);
 
     // '('
@@ -278,8 +275,6 @@ void _compilation_engine_compileSubroutine(CompilationEngine *pThis)
     }
     advance(p_tokenizer);
 
-    free(vm_func_name);
-
 }
 
 void _compilation_engine_compileParameterlist(CompilationEngine *pThis)
@@ -288,27 +283,25 @@ void _compilation_engine_compileParameterlist(CompilationEngine *pThis)
     int i;
     char *type;
 
-    type = malloc(sizeof(char) * 1024);
-
     for (i = 0; (i < 2) && (is_type(p_tokenizer)); i++) {
         // type
         if (p_tokenizer->tokenType(p_tokenizer) == KEYWORD) {
             switch (p_tokenizer->keyWord(p_tokenizer)) {
                 case INT:
-                    strcpy(type, "int");
+                    type = "int";
                     break;
                 case CHAR:
-                    strcpy(type, "char");
+                    type = "char";
                     break;
                 case BOOLEAN:
-                    strcpy(type, "boolean");
+                    type = "boolean";
                     break;
                 default:
                     TOKEN_ERR("'int' or 'char' or 'boolean'");
                     exit (0);
             }
         } else if (p_tokenizer->tokenType(p_tokenizer) == INDENTIFIER) {
-            strcpy(type, p_tokenizer->current_token);
+            type = p_tokenizer->current_token;
         } else {
             TOKEN_ERR("'int' or 'char' or 'boolean' or 'identifier'");
             exit (0);
@@ -332,20 +325,20 @@ void _compilation_engine_compileParameterlist(CompilationEngine *pThis)
             if (p_tokenizer->tokenType(p_tokenizer) == KEYWORD) {
                 switch (p_tokenizer->keyWord(p_tokenizer)) {
                     case INT:
-                        strcpy(type, "int");
+                        type = "int";
                         break;
                     case CHAR:
-                        strcpy(type, "char");
+                        type = "char";
                         break;
                     case BOOLEAN:
-                        strcpy(type, "boolean");
+                        type = "boolean";
                         break;
                     default:
                         TOKEN_ERR("'int' or 'char' or 'boolean'");
                         exit (0);
                 }
             } else if (p_tokenizer->tokenType(p_tokenizer) == INDENTIFIER) {
-                strcpy(type, p_tokenizer->current_token);
+                type = p_tokenizer->current_token;
             } else {
                 TOKEN_ERR("'int' or 'char' or 'boolean' or 'identifier'");
                 exit (0);
@@ -362,8 +355,6 @@ void _compilation_engine_compileParameterlist(CompilationEngine *pThis)
         }
     };
 
-    free(type);
-
     return;
 
 }
@@ -373,8 +364,6 @@ void _compilation_engine_compileVarDec(CompilationEngine *pThis)
     JackTokenizer *p_tokenizer = &(pThis->tokenizer);
     char *type;
 
-    type = malloc(sizeof(char) * 1024);
-
     // 'var'
     if (!((p_tokenizer->tokenType(p_tokenizer) == KEYWORD)
                 && (p_tokenizer->keyWord(p_tokenizer) == VAR))) {
@@ -387,20 +376,20 @@ void _compilation_engine_compileVarDec(CompilationEngine *pThis)
     if (p_tokenizer->tokenType(p_tokenizer) == KEYWORD) {
         switch (p_tokenizer->keyWord(p_tokenizer)) {
             case INT:
-                strcpy(type, "int");
+                type = "int";
                 break;
             case CHAR:
-                strcpy(type, "char");
+                type = "char";
                 break;
             case BOOLEAN:
-                strcpy(type, "boolean");
+                type = "boolean";
                 break;
             default:
                 TOKEN_ERR("'int' or 'char' or 'boolean'");
                 exit (0);
         }
     } else if (p_tokenizer->tokenType(p_tokenizer) == INDENTIFIER) {
-        strcpy(type, p_tokenizer->current_token);
+        type = p_tokenizer->current_token;
     } else {
         TOKEN_ERR("'int' or 'char' or 'boolean' or 'identifier'");
         exit (0);
@@ -435,8 +424,6 @@ void _compilation_engine_compileVarDec(CompilationEngine *pThis)
         exit (0);
     }
     advance(p_tokenizer);
-
-    free(type);
 }
 
 void _compilation_engine_compileStatements(CompilationEngine *pThis)
@@ -483,9 +470,6 @@ void _compilation_engine_compileDo(CompilationEngine *pThis)
     unsigned int i;
     enum kind kind;
 
-    vm_func_name = malloc(sizeof(char) * 1024);
-    identifier = malloc(sizeof(char) * 1024);
-
     // 'do'
     if (!((p_tokenizer->tokenType(p_tokenizer) == KEYWORD)
                 && (p_tokenizer->keyWord(p_tokenizer) == DO))) {
@@ -500,11 +484,11 @@ void _compilation_engine_compileDo(CompilationEngine *pThis)
         TOKEN_ERR("identifier");
         exit (0);
     }
-    strcpy(identifier, p_tokenizer->current_token);
+    identifier = p_tokenizer->current_token;
     advance(p_tokenizer);
 
     if (!strcmp(p_tokenizer->symbol(p_tokenizer), "(")) {
-        sprintf(vm_func_name, "%s.%s", pThis->class_name, identifier);
+        vm_func_name = pThis->strings.format(&(pThis->strings), "%s.%s", pThis->class_name, identifier);
         // '('
         if ((p_tokenizer->tokenType(p_tokenizer) != SYMBOL) ||
                 (strcmp(p_tokenizer->symbol(p_tokenizer), "("))) {
@@ -540,9 +524,9 @@ void _compilation_engine_compileDo(CompilationEngine *pThis)
 
         kind = pThis->symbols.kindOf(&(pThis->symbols), identifier);
         if (kind == ID_NONE)
-            sprintf(vm_func_name, "%s.%s", identifier, pThis->tokenizer.identifier(&(pThis->tokenizer)));
+            vm_func_name = pThis->strings.format(&(pThis->strings), "%s.%s", identifier, pThis->tokenizer.identifier(&(pThis->tokenizer)));
         else
-            sprintf(vm_func_name, "%s.%s", pThis->symbols.typeOf(&(pThis->symbols), identifier), p_tokenizer->current_token);
+            vm_func_name = pThis->strings.format(&(pThis->strings), "%s.%s", pThis->symbols.typeOf(&(pThis->symbols), identifier), p_tokenizer->current_token);
 
         advance(p_tokenizer);
 
@@ -589,9 +573,6 @@ void _compilation_engine_compileDo(CompilationEngine *pThis)
         exit (0);
     }
     advance(p_tokenizer);
-
-    free(vm_func_name);
-    free(identifier);
 }
 
 void _compilation_engine_compileLet(CompilationEngine *pThis)
@@ -605,10 +586,6 @@ void _compilation_engine_compileLet(CompilationEngine *pThis)
         {ID_VAR, SEG_LOCAL},     {ID_FIELD, SEG_THIS},
     };
     bool is_array_elem = false;
-    static unsigned int tmp_index_base = 0;
-    unsigned int tmp_index;
-
-    var_name = malloc(sizeof(char) * 1024);
 
     // 'let'
     if (!((p_tokenizer->tokenType(p_tokenizer) == KEYWORD)
@@ -623,13 +600,12 @@ void _compilation_engine_compileLet(CompilationEngine *pThis)
         TOKEN_ERR("identifier");
         exit (0);
     }
-    strcpy(var_name, pThis->tokenizer.identifier(&(pThis->tokenizer)));
+    var_name = pThis->tokenizer.identifier(&(pThis->tokenizer));
     advance(p_tokenizer);
 
     // ('[' expression ']')?
     for (i = 0; (i < 2) && (!strcmp(p_tokenizer->current_token, "[")); i++) {
         is_array_elem = true;
-        tmp_index = tmp_index_base % 7 + 1;
 
         // '['
         if ((p_tokenizer->tokenType(p_tokenizer) != SYMBOL) ||
@@ -646,7 +622,6 @@ void _compilation_engine_compileLet(CompilationEngine *pThis)
         pThis->writer.writePush(&(pThis->writer),
                 knd_seg_tbl[i].seg, p_symbols->indexOf(p_symbols, var_name));
         pThis->writer.writeArithmetic(&(pThis->writer), COM_ADD);
-        pThis->writer.writePop(&(pThis->writer), SEG_TEMP, tmp_index);
 
         // ']'
         if ((p_tokenizer->tokenType(p_tokenizer) != SYMBOL) ||
@@ -668,12 +643,13 @@ void _compilation_engine_compileLet(CompilationEngine *pThis)
     // expression
     pThis->compileExpression(pThis);
 
-    // write code
+    // write code; the element address stays on the stack while the value
+    // is computed, so calls made by the expression cannot overwrite it
     if (is_array_elem) {
-        pThis->writer.writePush(&(pThis->writer), SEG_TEMP, tmp_index);
+        pThis->writer.writePop(&(pThis->writer), SEG_TEMP, 0);
         pThis->writer.writePop(&(pThis->writer), SEG_POINTER, 1);
+        pThis->writer.writePush(&(pThis->writer), SEG_TEMP, 0);
         pThis->writer.writePop(&(pThis->writer), SEG_THAT, 0);
-        tmp_index_base++;
     } else {
         for (i = 0; knd_seg_tbl[i].kind != p_symbols->kindOf(p_symbols, var_name); i++);
         pThis->writer.writePop(&(pThis->writer),
@@ -687,20 +663,15 @@ void _compilation_engine_compileLet(CompilationEngine *pThis)
         exit (0);
     }
     advance(p_tokenizer);
-
-    free(var_name);
 }
 
 
 void _compilation_engine_compileWhile(CompilationEngine *pThis)
 {
     JackTokenizer *p_tokenizer = &(pThis->tokenizer);;
-    static unsigned int n_label = 0;
     unsigned int tmp_n_label;
     char *label_name;
 
-    label_name = malloc(sizeof(char) * 1024);
-
     // 'while'
     if (!((p_tokenizer->tokenType(p_tokenizer) == KEYWORD)
                 && (p_tokenizer->keyWord(p_tokenizer) == WHILE))) {
@@ -710,9 +681,9 @@ void _compilation_engine_compileWhile(CompilationEngine *pThis)
     advance(p_tokenizer);
 
     // write label in-position
-    tmp_n_label = n_label;
-    n_label++;
-    sprintf(label_name, "while_%d_in", tmp_n_label);
+    tmp_n_label = pThis->n_while_label;
+    pThis->n_while_label++;
+    label_name = pThis->strings.format(&(pThis->strings), "while_%d_in", tmp_n_label);
     pThis->writer.writeLabel(&(pThis->writer), label_name);
 
     // '('
@@ -735,7 +706,7 @@ void _compilation_engine_compileWhile(CompilationEngine *pThis)
     advance(p_tokenizer);
 
     // write if-go out
-    sprintf(label_name, "while_%d_out", tmp_n_label);
+    label_name = pThis->strings.format(&(pThis->strings), "while_%d_out", tmp_n_label);
     pThis->writer.writeArithmetic(&(pThis->writer), COM_NOT);
     pThis->writer.writeIf(&(pThis->writer), label_name);
 
@@ -759,14 +730,12 @@ void _compilation_engine_compileWhile(CompilationEngine *pThis)
     advance(p_tokenizer);
 
     // write goto in
-    sprintf(label_name, "while_%d_in", tmp_n_label);
+    label_name = pThis->strings.format(&(pThis->strings), "while_%d_in", tmp_n_label);
     pThis->writer.writeGoto(&(pThis->writer), label_name);
 
     // write label out-position
-    sprintf(label_name, "while_%d_out", tmp_n_label);
+    label_name = pThis->strings.format(&(pThis->strings), "while_%d_out", tmp_n_label);
     pThis->writer.writeLabel(&(pThis->writer), label_name);
-
-    free(label_name);
 }
 
 void _compilation_engine_compileReturn(CompilationEngine *pThis)
@@ -804,12 +773,9 @@ void _compilation_engine_compileIf(CompilationEngine *pThis)
 {
     JackTokenizer *p_tokenizer = &(pThis->tokenizer);
     int i;
-    static unsigned int n_label = 0;
     unsigned int tmp_n_label;
     char *label_name;
 
-    label_name = malloc(sizeof(char) * 1024);
-
     // 'if'
     if (!((p_tokenizer->tokenType(p_tokenizer) == KEYWORD)
                 && (p_tokenizer->keyWord(p_tokenizer) == IF))) {
@@ -818,8 +784,8 @@ void _compilation_engine_compileIf(CompilationEngine *pThis)
     }
     advance(p_tokenizer);
 
-    tmp_n_label = n_label;
-    n_label++;
+    tmp_n_label = pThis->n_if_label;
+    pThis->n_if_label++;
 
     // '('
     if ((p_tokenizer->tokenType(p_tokenizer) != SYMBOL) ||
@@ -841,7 +807,7 @@ void _compilation_engine_compileIf(CompilationEngine *pThis)
     advance(p_tokenizer);
 
     // write if-go else
-    sprintf(label_name, "if_%d_else", tmp_n_label);
+    label_name = pThis->strings.format(&(pThis->strings), "if_%d_else", tmp_n_label);
     pThis->writer.writeArithmetic(&(pThis->writer), COM_NOT);
     pThis->writer.writeIf(&(pThis->writer), label_name);
 
@@ -865,11 +831,11 @@ void _compilation_engine_compileIf(CompilationEngine *pThis)
     advance(p_tokenizer);
 
     // write goto out 
-    sprintf(label_name, "if_%d_out", tmp_n_label);
+    label_name = pThis->strings.format(&(pThis->strings), "if_%d_out", tmp_n_label);
     pThis->writer.writeGoto(&(pThis->writer), label_name);
 
     // write label else-position
-    sprintf(label_name, "if_%d_else", tmp_n_label);
+    label_name = pThis->strings.format(&(pThis->strings), "if_%d_else", tmp_n_label);
     pThis->writer.writeLabel(&(pThis->writer), label_name);
 
     for (i = 0; (i < 2) && (p_tokenizer->keyWord(p_tokenizer) == ELSE); i++) {
@@ -902,14 +868,14 @@ void _compilation_engine_compileIf(CompilationEngine *pThis)
     }
 
     // write label out-position
-    sprintf(label_name, "if_%d_out", tmp_n_label);
+    label_name = pThis->strings.format(&(pThis->strings), "if_%d_out", tmp_n_label);
     pThis->writer.writeLabel(&(pThis->writer), label_name);
 }
 
 void _compilation_engine_compileExpression(CompilationEngine *pThis)
 {
     JackTokenizer *p_tokenizer = &(pThis->tokenizer);
-    char op[2];
+    char *op;
     struct {char op[2]; enum command com;} op_tbl[7] =
         {{"+", COM_ADD}, {"-", COM_SUB}, {"=", COM_EQ},
          {">", COM_GT},  {"<", COM_LT},  {"&", COM_AND}, {"|", COM_OR},
@@ -922,13 +888,13 @@ void _compilation_engine_compileExpression(CompilationEngine *pThis)
 
     // (op term)*
     while (is_op(p_tokenizer)) {
-        strcpy(op, p_tokenizer->current_token);
+        op = p_tokenizer->current_token;
         advance(p_tokenizer);
 
         pThis->compileTerm(pThis);
 
         // write op
-        for (i = 0; strcmp(op_tbl[i].op, op) && i < 7; i++);
+        for (i = 0; i < 7 && strcmp(op_tbl[i].op, op); i++);
         if (i < 7) {
             pThis->writer.writeArithmetic(&(pThis->writer), op_tbl[i].com);
         } else if (!strcmp(op, "/")) {
@@ -943,7 +909,7 @@ void _compilation_engine_compileTerm(CompilationEngine *pThis)
 {
     JackTokenizer *p_tokenizer = &(pThis->tokenizer);
     SymbolTable *p_symbols = &(pThis->symbols);
-    char op[2];
+    char *op;
     struct {char op[2]; enum command com;} op_tbl[2] =
         {{"-", COM_NEG}, {"~", COM_NOT}, 
     };
@@ -956,9 +922,6 @@ void _compilation_engine_compileTerm(CompilationEngine *pThis)
     enum kind kind;
     char *str;
 
-    identifier = malloc(sizeof(char) * 1024);
-    subroutine_name = malloc(sizeof(char) * 1024);
-
     switch (p_tokenizer->tokenType(p_tokenizer)) {
         case INT_CONST:
             // integerConstant
@@ -1007,7 +970,7 @@ void _compilation_engine_compileTerm(CompilationEngine *pThis)
             if (!strcmp(p_tokenizer->symbol(p_tokenizer), "-")
                     || !strcmp(p_tokenizer->symbol(p_tokenizer), "~")
                ) {
-                strcpy(op, p_tokenizer->current_token);
+                op = p_tokenizer->current_token;
                 advance(p_tokenizer);
 
                 pThis->compileTerm(pThis);
@@ -1050,7 +1013,7 @@ void _compilation_engine_compileTerm(CompilationEngine *pThis)
                 TOKEN_ERR("identifier");
                 exit (0);
             }
-            strcpy(identifier, pThis->tokenizer.identifier(&(pThis->tokenizer)));
+            identifier = pThis->tokenizer.identifier(&(pThis->tokenizer));
             advance(p_tokenizer);
 
             if (!strcmp(p_tokenizer->identifier(p_tokenizer), "[")) {
@@ -1105,7 +1068,7 @@ void _compilation_engine_compileTerm(CompilationEngine *pThis)
                 advance(p_tokenizer);
 
                 // write code
-                sprintf(subroutine_name, "%s.%s", pThis->class_name, identifier);
+                subroutine_name = pThis->strings.format(&(pThis->strings), "%s.%s", pThis->class_name, identifier);
                 pThis->writer.writeCall(&(pThis->writer), subroutine_name, pThis->nArgs);
 
             } else if (!strcmp(p_tokenizer->symbol(p_tokenizer), ".")) {
@@ -1118,9 +1081,9 @@ void _compilation_engine_compileTerm(CompilationEngine *pThis)
                 }
                 kind = pThis->symbols.kindOf(&(pThis->symbols), identifier);
                 if (kind == ID_NONE)
-                    sprintf(subroutine_name, "%s.%s", identifier, pThis->tokenizer.identifier(&(pThis->tokenizer)));
+                    subroutine_name = pThis->strings.format(&(pThis->strings), "%s.%s", identifier, pThis->tokenizer.identifier(&(pThis->tokenizer)));
                 else
-                    sprintf(subroutine_name, "%s.%s", pThis->symbols.typeOf(&(pThis->symbols), identifier), p_tokenizer->current_token);
+                    subroutine_name = pThis->strings.format(&(pThis->strings), "%s.%s", pThis->symbols.typeOf(&(pThis->symbols), identifier), p_tokenizer->current_token);
                 advance(p_tokenizer);
 
                 // '('
@@ -1168,9 +1131,6 @@ void _compilation_engine_compileTerm(CompilationEngine *pThis)
             break;
     }
 
-    free(identifier);
-    free(subroutine_name);
-
 }
 
 void _compilation_engine_compileExpressionList(CompilationEngine *pThis)
@@ -1207,8 +1167,7 @@ void _compilation_engine_del(CompilationEngine *pThis)
 
     p_tokenizer->del(p_tokenizer);
     pThis->writer.close(&pThis->writer);
-
-    free(pThis->class_name);
+    pThis->strings.del(&pThis->strings);
     return;
 }
 
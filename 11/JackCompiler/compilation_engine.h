@@ -8,6 +8,7 @@
 #include "jack_tokenizer.h"
 #include "symbol_table.h"
 #include "vm_writer.h"
+#include "string_arena.h"
 #include <stdio.h>
 
 enum id_status {
@@ -20,11 +21,17 @@ typedef struct compilation_engine {
     JackTokenizer tokenizer;
     SymbolTable   symbols;
     VMWriter      writer;
+    StringArena   strings;      // composed names and labels of this file
     FILE *fp;
-    char *class_name;
+    char *class_name;           // identifiers point into the tokenizer's names
     unsigned int nArgs;
     enum KeyWord ret_type;
 
+    // numbers of the next while and if labels; VM labels are scoped to
+    // their function, so every file starts from 0
+    unsigned int n_while_label;
+    unsigned int n_if_label;
+
     void (*init)(struct compilation_engine *, char *, char *);
     void (*compileClass)(struct compilation_engine *);
     void (*compileClassVarDec)(struct compilation_engine *);
@@ -66,7 +73,10 @@ extern void _compilation_engine_del(CompilationEngine *pThis);
     .tokenizer              = newJackTokenizer(),                           \
     .symbols                = newSymbolTable(),                             \
     .writer                 = newVMWriter(),                                \
+    .strings                = newStringArena(),                             \
     .fp                     = NULL,                                         \
+    .n_while_label          = 0,                                            \
+    .n_if_label             = 0,                                            \
     .init                   = _compilation_engine_init,                     \
     .compileClass           = _compilation_engine_compileClass,             \
     .compileClassVarDec     = _compilation_engine_compileClassVarDec,       \
@@ -0,0 +1 @@
+../../07/VMtranslator/file_list.c
\ No newline at end of file
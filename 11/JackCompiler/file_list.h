@@ -0,0 +1 @@
+../../07/VMtranslator/file_list.h
\ No newline at end of file
@@ -2,224 +2,183 @@
  * jack_compiler.c
  */
 
-#include <sys/stat.h>
 #include <stdbool.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
-#include <dirent.h>
-#include <libgen.h>
 #include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "compilation_engine.h"
+#include "file_list.h"
 
-struct filename {
-    char *fullname;
-    char *basename;
-    char *extension;
+// one class, compiled by whichever worker takes it
+struct compile_unit {
+    struct filename *file;
 };
 
-struct filename_list {
-    struct filename *filenames;
-    size_t size;
+// state shared by the worker threads; only next is written, under lock
+struct compile_context {
+    struct compile_unit *units;
+    int num_units;
+    int next;
+    pthread_mutex_t lock;
+    bool dump_tokens;
 };
 
-static bool isDir(const char *path);
-
-static void initFilenameList(struct filename_list *list, size_t size);
-static void insertFileNameList(struct filename_list *list, const char *filename);
-static void delFileNameList(struct filename_list *list);
-static int countDirectoryEntry(char *filename);
+static void usage(const char *name);
+static void runWorkers(struct compile_context *context);
+static void *compileWorker(void *arg);
+static void compileUnit(struct compile_context *context, struct compile_unit *unit);
+static void writeTokens(JackTokenizer *tokenizer, const char *basename);
 
 int main(int argc, char **argv)
 {
-    CompilationEngine engine = newCompilationEngine();
-    JackTokenizer tokenizer = newJackTokenizer();
-    DIR *dirp; struct dirent *dp; struct filename_list filename_list;
-    char *fullpath, *buf1, *buf2, *base, *dot;
-    int i;
-    FILE *fp;
+    FileList file_list = newFileList();
+    struct compile_context context;
+    int i, opt;
+    bool dump_tokens = false;
+
+    while ((opt = getopt(argc, argv, "x")) != -1) {
+        switch (opt) {
+            case 'x':
+                dump_tokens = true;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
 
-    if (argc != 2) {
+    if (argc < 2) {
         printf("Error: argument is invalid\n");
         return 1;
     }
 
-    // get filename list
-    if (isDir(argv[1])) {
-        initFilenameList(&filename_list, countDirectoryEntry(argv[1]));
-
-        dirp = opendir(argv[1]);
-        if (dirp == NULL) {
-            fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
-            exit errno;
-        }
-
-        while ((dp = readdir(dirp)) != NULL) {
-            fullpath = (char *)malloc(sizeof(char) * (strlen(argv[1]) + strlen(dp->d_name) + 2));
-            strcpy(fullpath, argv[1]);
-            strcat(fullpath, "/");
-            strcat(fullpath, dp->d_name);
-            insertFileNameList(&filename_list, fullpath);
-            free(fullpath);
-        }
-        closedir(dirp);
-    } else {
-        initFilenameList(&filename_list, 1);
-        insertFileNameList(&filename_list, argv[1]);
-    }
-
-    // set output filename to code writer module
-    buf1 = (char *)malloc(sizeof(char) * strlen(argv[1]) + 1);
-    strcpy(buf1, argv[1]);
-    base = strrchr(buf1, '/');
-    if (base == NULL) base = buf1;
-    else base += 1;
+    // every file and directory on the command line, one .vm per class
+    file_list.init(&file_list, "jack");
+    for (i = 1; i < argc; i++)
+        file_list.add(&file_list, argv[i]);
 
-    if (!isDir(argv[1])) {
-        dot = strrchr(buf1, '.');
-        *dot = '\0';
+    // each class is written to ./<name>.vm, so two with one name would
+    // overwrite each other
+    if (!file_list.checkNames(&file_list)) {
+        file_list.del(&file_list);
+        return 1;
     }
-    buf2 = (char *)malloc(sizeof(char) * strlen(base) + strlen(".asm") + 1);
-    strcpy(buf2, base);
-    strcat(buf2, ".asm");
-    free(buf1);
-    free(buf2);
-
-    for (i = 0; (size_t)i < filename_list.size; i++) {
-        if (filename_list.filenames[i].fullname == NULL) break;
-        if (strcmp(filename_list.filenames[i].extension, "jack")) continue;
-
-        buf1 = (char *)malloc(sizeof(char) * (strlen(filename_list.filenames[i].basename) + 3));
-        buf2 = (char *)malloc(sizeof(char) * (strlen(filename_list.filenames[i].basename) + 5));
-        strcpy(buf1, filename_list.filenames[i].basename);
-        strcat(buf1, ".vm");
-        strcpy(buf2, filename_list.filenames[i].basename);
-        strcat(buf2, "T.xml");
-        engine.init(&engine, filename_list.filenames[i].fullname, buf1);
-        tokenizer.init(&tokenizer, filename_list.filenames[i].fullname);
-
-        fp = fopen(buf2, "w");
-        while(tokenizer.hasMoreTokens(&tokenizer)) {
-            tokenizer.advance(&tokenizer);
-            tokenizer.printCurrentToken(&tokenizer, fp);
-        }
-        fclose(fp);
 
-        if (engine.tokenizer.hasMoreTokens(&engine.tokenizer))
-            engine.tokenizer.advance(&engine.tokenizer);
+    context.num_units = file_list.num_files;
+    context.units = (struct compile_unit *)calloc(context.num_units + 1, sizeof(struct compile_unit));
+    for (i = 0; i < context.num_units; i++)
+        context.units[i].file = &file_list.filenames[i];
+    pthread_mutex_init(&context.lock, NULL);
+    context.dump_tokens = dump_tokens;
 
-        engine.compileClass(&engine);
-        engine.del(&engine);
-        free(buf1);
-    }
+    // the classes are compiled several at a time, each on its own engine;
+    // nothing one class emits depends on another
+    runWorkers(&context);
 
-    delFileNameList(&filename_list);
+    pthread_mutex_destroy(&context.lock);
+    free(context.units);
+    file_list.del(&file_list);
     return 0;
 }
 
-static bool isDir(const char *path)
+static void usage(const char *name)
 {
-    struct stat s;
-    int ret;
-
-    ret = stat(path, &s);
-
-    if (ret == -1) {
-        fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
-        exit errno;
-    }
-
-    if (S_ISDIR(s.st_mode))
-        return true;
-    else
-        return false;
+    printf("Usage: %s [-x] source...\n", name);
 }
 
-static void initFilenameList(struct filename_list *list, size_t size)
+// compile every unit, with one thread per processor
+static void runWorkers(struct compile_context *context)
 {
-    if (list == NULL) return;
+    pthread_t *threads;
+    int i, num_threads;
 
-    list->filenames = (struct filename *)malloc(sizeof(struct filename) * size);
-    if (list->filenames == NULL) return;
-    memset(list->filenames, (int)NULL, sizeof(struct filename) * size);
-    list->size      = size;
+    context->next = 0;
 
-    return;
+    num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_threads > context->num_units) num_threads = context->num_units;
+    if (num_threads < 1) num_threads = 1;
+
+    threads = (pthread_t *)malloc(sizeof(pthread_t) * num_threads);
+    for (i = 0; i < num_threads; i++) {
+        errno = pthread_create(&threads[i], NULL, compileWorker, context);
+        if (errno != 0) {
+            fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
+            exit errno;
+        }
+    }
+    for (i = 0; i < num_threads; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
 }
 
-static void insertFileNameList(struct filename_list *list, const char *filename)
+static void *compileWorker(void *arg)
 {
-    struct filename *filenames = list->filenames;
-    char *buf, *dot, *bname;
+    struct compile_context *context = (struct compile_context *)arg;
+    int index;
 
-    if (list == NULL) return;
+    for (;;) {
+        pthread_mutex_lock(&context->lock);
+        index = context->next++;
+        pthread_mutex_unlock(&context->lock);
 
-    while ((filenames->fullname) !=  NULL)
-        filenames++;
+        if (index >= context->num_units) break;
 
-    buf = (char *)malloc(sizeof(char) * strlen(filename) + 1);
-    if (buf == NULL) return;
-    strcpy(buf, filename);
+        compileUnit(context, &context->units[index]);
+    }
 
-    filenames->fullname = (char *)malloc(sizeof(char) * strlen(buf) + 1);
-    if (filenames->fullname == NULL) return;
-    strcpy(filenames->fullname, buf);
+    return NULL;
+}
 
-    dot = strrchr(buf, '.');
+static void compileUnit(struct compile_context *context, struct compile_unit *unit)
+{
+    CompilationEngine engine = newCompilationEngine();
+    struct filename *file = unit->file;
+    char *buf;
 
-    bname = basename(buf);
+    buf = (char *)malloc(sizeof(char) * (strlen(file->basename) + strlen(".vm") + 1));
+    strcpy(buf, file->basename);
+    strcat(buf, ".vm");
+    engine.init(&engine, file->fullname, buf);
 
-    if (bname == NULL) {
-        filenames->basename  = NULL;
-        filenames->extension = NULL;
-    } else {
-        dot = strrchr(bname, '.');
-        *dot = '\0';
-        filenames->basename  = (char *)malloc(sizeof(char) * strlen(bname) + 1);
-        strcpy(filenames->basename, bname);
+    // the token dump is only written on request
+    if (context->dump_tokens)
+        writeTokens(&engine.tokenizer, file->basename);
 
-        filenames->extension = (char *)malloc(sizeof(char) * strlen(dot + 1) + 1);
-        if ((filenames->basename == NULL) || (filenames->extension == NULL)) return;
-        strcpy(filenames->extension, dot + 1);
-    }
+    if (engine.tokenizer.hasMoreTokens(&engine.tokenizer))
+        engine.tokenizer.advance(&engine.tokenizer);
 
+    engine.compileClass(&engine);
+    engine.del(&engine);
     free(buf);
-    return;
 }
 
-static void delFileNameList(struct filename_list *list)
+// <basename>T.xml from the tokens the compiler is about to use; the
+// tokenizer is rewound so the compile still starts at the first token
+static void writeTokens(JackTokenizer *tokenizer, const char *basename)
 {
-    size_t i;
-    for (i = 0; i < list->size; i++) {
-        free(list->filenames[i].extension);
-        free(list->filenames[i].basename);
-        free(list->filenames[i].fullname);
-    }
-
-    free(list->filenames);
-    list->size = 0;
-
-    return;
-}
+    char *buf;
+    FILE *fp;
 
-static int countDirectoryEntry(char *filename)
-{
-    DIR *dirp;
-    struct dirent *dp;
-    int count = 0;
+    buf = (char *)malloc(sizeof(char) * (strlen(basename) + strlen("T.xml") + 1));
+    strcpy(buf, basename);
+    strcat(buf, "T.xml");
 
-    dirp = opendir(filename);
-    if (dirp == NULL) {
+    fp = fopen(buf, "w");
+    if (fp == NULL) {
         fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
-        return 0;
+        exit errno;
     }
-
-    while ((dp = readdir(dirp)) != NULL) {
-        count++;
+    while (tokenizer->hasMoreTokens(tokenizer)) {
+        tokenizer->advance(tokenizer);
+        tokenizer->printCurrentToken(tokenizer, fp);
     }
-
-    closedir(dirp);
-
-    return count;
+    fclose(fp);
+    tokenizer->reset(tokenizer);
+    free(buf);
 }
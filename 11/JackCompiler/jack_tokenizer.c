@@ -9,9 +9,52 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
-#include <ctype.h>
-
-#define SIZE_OF_ARRAY(a) ((sizeof(a)) / (sizeof(a[0])))
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define ENTRY_BLOCK_SIZE 1024
+#define NAME_BLOCK_SIZE  4096
+#define NAME_TABLE_SIZE  256    // a power of two, doubled at half full
+
+// character classes of the source, indexed by an unsigned char or EOF
+#define B  CHAR_BLANK
+#define W  CHAR_WORD
+#define D  (CHAR_WORD | CHAR_DIGIT)
+#define S  CHAR_SYMBOL
+
+enum charClass {
+    CHAR_BLANK  = 1,
+    CHAR_WORD   = 2,
+    CHAR_DIGIT  = 4,
+    CHAR_SYMBOL = 8,
+};
+
+static const uint8_t char_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, B, B, 0, 0, B, 0, 0,   // 0x00
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,   // 0x10
+    B, 0, 0, 0, 0, 0, S, 0, S, S, S, S, S, S, S, S,   // 0x20
+    D, D, D, D, D, D, D, D, D, D, 0, S, S, S, S, 0,   // 0x30
+    0, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,   // 0x40
+    W, W, W, W, W, W, W, W, W, W, W, S, 0, S, 0, W,   // 0x50
+    0, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,   // 0x60
+    W, W, W, W, W, W, W, W, W, W, W, S, S, S, S, 0,   // 0x70
+};
+
+#undef B
+#undef W
+#undef D
+#undef S
+
+#define CHAR_CLASS(c) ((c) == EOF ? 0 : char_class[(unsigned char)(c)])
+#define IS_BLANK(c)   (CHAR_CLASS(c) & CHAR_BLANK)
+#define IS_WORD(c)    (CHAR_CLASS(c) & CHAR_WORD)
+#define IS_DIGIT(c)   (CHAR_CLASS(c) & CHAR_DIGIT)
+#define IS_SYMBOL(c)  (CHAR_CLASS(c) & CHAR_SYMBOL)
 
 const char *keyword[] = {"class", "method", "function", "constructor", "int",    "boolean",
                          "char",  "void",   "var",      "static",      "field",  "let",
@@ -19,314 +62,232 @@ const char *keyword[] = {"class", "method", "function", "constructor", "int",
                          "false", "null",   "this",
                         };
 
-static bool isKeyword(char *str);
-static bool isSymbol(char *str);
-static bool isConstantInt(char *str);
-static bool isConstantStr(char *str);
-static bool isIdentifier(char *str);
-static struct token getTokenInfo(char *str);
-static void printToken(struct token token, FILE *fp);
+// keywords by a perfect hash of their length and first and last characters
+#define KEYWORD_HASH(text, len) \
+    (((unsigned char)(text)[0] * 8 + (unsigned char)(text)[(len) - 1] * 27 + (len)) & 31)
+
+static const uint8_t keyword_slot[32] = {
+    VOID,        FIELD,       CHAR,        MAX_KEYWORD,
+    WHILE,       THIS,        MAX_KEYWORD, INT,
+    MAX_KEYWORD, CONSTRUCTOR, MAX_KEYWORD, TRUE,
+    IF,          MAX_KEYWORD, MAX_KEYWORD, STATIC,
+    RETURN,      BOOLEAN,     FUNCTION,    ELSE,
+    MAX_KEYWORD, MAX_KEYWORD, MAX_KEYWORD, DO,
+    NUL,         VAR,         METHOD,      MAX_KEYWORD,
+    FALSE,       MAX_KEYWORD, CLASS,       LET,
+};
+
+static enum KeyWord findKeyword(const char *text, size_t len);
+static void classifyToken(const char *text, size_t len, struct token_entry *entry);
+static void printToken(struct token_entry *entry, char *text, FILE *fp);
 static char *formatXML(const char *in, char *out);
+static int peek(JackTokenizer *pThis, size_t offset);
+static bool skipBlanks(JackTokenizer *pThis);
+static size_t skipSpaces(const char *data, size_t pos, size_t size);
+static size_t findByte(const char *data, size_t pos, size_t size, char c);
+static void scanToken(JackTokenizer *pThis);
+static void scanFile(JackTokenizer *pThis);
+static uint32_t internName(JackTokenizer *pThis, const char *text, size_t len);
+static void growNameTable(JackTokenizer *pThis);
+static uint32_t hashName(const char *text, size_t len);
 
 void _jack_tokenizer_init(JackTokenizer *pThis, char *name)
 {
-    pThis->fp = fopen(name, "r");
+    struct stat st;
+    int fd;
+
+    fd = open(name, O_RDONLY);
 
-    if (pThis->fp == NULL) {
+    if (fd == -1 || fstat(fd, &st) == -1) {
         fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
         exit errno;
     }
 
-    memset(&pThis->token, 0, sizeof(pThis->token));
-    pThis->current_token = NULL;
-
-    return;
-}
+    pThis->data = NULL;
+    pThis->size = st.st_size;
+    pThis->pos  = 0;
 
-bool _jack_tokenizer_hasMoreTokens(JackTokenizer *pThis)
-{
-    int c;
-    bool oneline_comment = false;
-    bool multiline_commnent = false;
-    char buf[4] = {0};
-    unsigned long int i = 0;
-
-    while ((c = fgetc(pThis->fp)) != EOF) {
-        buf[i % 4] = (char)c;
-        i++;
-
-        if (oneline_comment) {
-            if (c == '\n') {
-                oneline_comment = false;
-                continue;
-            } else {
-                continue;
-            }
+    // the whole source is scanned in place with a cursor
+    if (pThis->size != 0) {
+        pThis->data = (char *)mmap(NULL, pThis->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (pThis->data == MAP_FAILED) {
+            fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
+            exit errno;
         }
+    }
+    close(fd);
 
-        if (multiline_commnent) {
-            if (buf[(i - 2) % 4] == '*' && c == '/') {
-                multiline_commnent = false;
-                continue;
-            } else {
-                continue;
-            }
-        }
+    pThis->names_size = NAME_BLOCK_SIZE;
+    pThis->names = (char *)malloc(sizeof(char) * pThis->names_size);
+    pThis->names[0] = '\0';                 // name 0 is the empty text
+    pThis->names_len = 1;
+    pThis->name_table_size = NAME_TABLE_SIZE;
+    pThis->name_table = (uint32_t *)calloc(pThis->name_table_size, sizeof(uint32_t));
+    pThis->num_names = 0;
 
-        if (buf[(i - 2) % 4] == '/') {
-            if (c == '*') {
-                multiline_commnent = true;
-                continue;
-            } else if (c == '/') {
-                oneline_comment = true;
-                continue;
-            } else if (buf[(i - 3) % 4] != '*'){
-                fseek(pThis->fp, -2, SEEK_CUR);
-                return true;
-            }
-        }
+    // the file is tokenized once; every pass after that walks the array
+    scanFile(pThis);
+    _jack_tokenizer_reset(pThis);
 
-        if ((c == ' ') || (c == '\n') || (c == '\r') || (c == '/') || (c == '\t')) continue;
-
-        fseek(pThis->fp, -1, SEEK_CUR);
-        return true;
-    }
+    return;
+}
 
-    if (buf[(i - 2) % 4] == '/') {
-        fseek(pThis->fp, -2, SEEK_CUR);
-        return true;
-    } else {
-        return false;
-    }
+bool _jack_tokenizer_hasMoreTokens(JackTokenizer *pThis)
+{
+    return pThis->next < pThis->num_tokens;
 }
 
+// nothing is copied: the current token's text is its interned name
 void _jack_tokenizer_advance(JackTokenizer *pThis)
 {
-    char c;
-    char *buf;
-    unsigned int i;
-    static const int buf_block_size = 256;
-    bool in_quote = false;;
-
-    buf = (char *)malloc(sizeof(char *) * buf_block_size);
-
-    for (i = 0; (c = fgetc(pThis->fp)) != EOF; i++) {
-        if (c == '\n') break;
-
-        if (!in_quote) {
-            if (c == ' ') break;
-
-            if (i == 0) {
-                if (c == '"' ) in_quote = true;
-            } else {
-                if (buf[i - 1] == '/' && (c == '/' || c == '*')) {
-                    fseek(pThis->fp, -1, SEEK_CUR);
-                    break;
-                }
-
-                if (!(isalpha(buf[0]) || isdigit(buf[0]) || buf[0] == '_')) {
-                    break;
-                }
-
-                if (!(isalpha(c) || isdigit(c) || c == '_' || c == '"')) {
-                    break;
-                }
-            }
-        } else {
-            if (i != 1 && buf[i - 1] == '"') break;
-        }
-
-
-        buf[i] = c;
-
-        if ((i % buf_block_size) == (buf_block_size - 1)) {
-            buf = (char *)realloc(buf, sizeof(char *) * (i / (buf_block_size + 1)));
-        }
+    if (pThis->next >= pThis->num_tokens) {
+        _jack_tokenizer_reset(pThis);
+        pThis->next = pThis->num_tokens;
+        return;
     }
-    if (c != EOF) fseek(pThis->fp, -1, SEEK_CUR);
-    buf[i] = '\0';
 
-    free(pThis->current_token);
-    pThis->current_token = (char *)malloc(sizeof(char *) * (strlen(buf) + 1));
-    strcpy(pThis->current_token, buf);
+    pThis->current = &pThis->tokens[pThis->next++];
+    pThis->current_token = pThis->names + pThis->current->name;
 
-    free(buf);
+    return;
+}
 
-    pThis->token = getTokenInfo(pThis->current_token);
+// back to the first token, for another pass over the same file
+void _jack_tokenizer_reset(JackTokenizer *pThis)
+{
+    pThis->next = 0;
+    pThis->current = NULL;
+    pThis->current_token = pThis->names;
 
     return;
 }
 
 enum TokenType _jack_tokenizer_tokenType(JackTokenizer *pThis)
 {
-    return pThis->token.type;
+    return pThis->current ? pThis->current->type : MAX_TOKEN_TYPE;
 }
 
 enum KeyWord _jack_tokenizer_keyWord(JackTokenizer *pThis)
 {
-    return pThis->token.data.keyword;
+    return pThis->current && pThis->current->type == KEYWORD ? pThis->current->code : MAX_KEYWORD;
 }
 
 char *_jack_tokenizer_symbol(JackTokenizer *pThis)
 {
-    return pThis->token.data.symbol;
+    return pThis->current_token;
 }
 
 char *_jack_tokenizer_identifier(JackTokenizer *pThis)
 {
-    return pThis->token.data.identifier;
+    return pThis->current_token;
 }
 
 int  _jack_tokenizer_intVal(JackTokenizer *pThis)
 {
-    return pThis->token.data.int_const;
+    return atoi(pThis->current_token);
 }
 
 char *_jack_tokenizer_stringVal(JackTokenizer *pThis)
 {
-    return pThis->token.data.str_const;
+    return pThis->current_token;
 }
 
 void _jack_tokenizer_print_cur_token(JackTokenizer *pThis, FILE *fp)
 {
-    printToken(pThis->token, fp);
+    if (pThis->current != NULL)
+        printToken(pThis->current, pThis->current_token, fp);
 }
 
 void _jack_tokenizer_del(JackTokenizer *pThis)
 {
-    fclose(pThis->fp);
-    memset(&pThis->token, 0, sizeof(pThis->token));
-    free(pThis->current_token);
+    if (pThis->data != NULL)
+        munmap(pThis->data, pThis->size);
+    pThis->data = NULL;
+    pThis->size = 0;
+    free(pThis->tokens);
+    pThis->tokens = NULL;
+    pThis->num_tokens = 0;
+    pThis->next = 0;
+    pThis->current = NULL;
+    free(pThis->names);
+    pThis->names = NULL;
+    pThis->current_token = NULL;
+    free(pThis->name_table);
+    pThis->name_table = NULL;
+    pThis->num_names = 0;
 
     return;
 }
 
-static bool isKeyword(char *str)
+static enum KeyWord findKeyword(const char *text, size_t len)
 {
-    int i;
+    enum KeyWord code;
 
-    for (i = 0; i < (int)SIZE_OF_ARRAY(keyword); i++) {
-        if (!strcmp(str, keyword[i])) return true;
-    }
+    if (len < 2 || len > 11) return MAX_KEYWORD;
 
-    return false;
-}
+    code = keyword_slot[KEYWORD_HASH(text, len)];
+    if (code == MAX_KEYWORD || strncmp(text, keyword[code], len) || keyword[code][len] != '\0')
+        return MAX_KEYWORD;
 
-static bool isSymbol(char *str)
-{
-    const char *symbol[] = {"{", "}", "(", ")", "[", "]", ".", ",", ";", "+", "-",
-                            "*", "/", "&", "|", "<", ">", "=", "~",
-                           };
-    int i;
-
-    for (i = 0; i < (int)SIZE_OF_ARRAY(symbol); i++) {
-        if (!strcmp(str, symbol[i])) return true;
-    }
-
-    return false;
+    return code;
 }
 
-static bool isConstantInt(char *str)
+// the type, and the keyword or symbol, of a scanned word or symbol
+static void classifyToken(const char *text, size_t len, struct token_entry *entry)
 {
-    int i;
-    for (i = 0; i < (int)strlen(str); i++) {
-        if (!isdigit(str[i])) return false;
-    }
+    size_t i;
 
-    return true;
-}
+    entry->code = 0;
 
-static bool isConstantStr(char *str)
-{
-    int i = 0;
+    if (IS_SYMBOL(text[0])) {
+        entry->type = SYMBOL;
+        entry->code = text[0];
 
-    if (str[0] != '"' || str[strlen(str) - 1] != '"') return false;
+    } else if (!IS_WORD(text[0])) {
+        entry->type = MAX_TOKEN_TYPE;
 
-    for (i = 1; i < (int)strlen(str) - 1; i++) {
-        if (str[i] == '\n') return false;
-    }
-    return true;
-}
-
-static bool isIdentifier(char *str)
-{
-    int i;
-    for (i = 0; i < (int)strlen(str); i++) {
-        if (!(isdigit(str[i]) || isalpha(str[i]) || str[i] == '_')) return false;
-    }
-
-    return true;
-}
-
-static struct token getTokenInfo(char *str)
-{
-    struct token token;
-    int i;
-
-    if (isKeyword(str)) {
-        token.type = KEYWORD;
-        token.data.keyword = MAX_KEYWORD;
-        for (i = 0; i < MAX_KEYWORD; i++) {
-            if (!strcmp(str, keyword[i]))
-                token.data.keyword = i;
-        }
-
-    } else if (isSymbol(str)) {
-        token.type = SYMBOL;
-        strncpy(token.data.symbol, str, sizeof(token.data.symbol) - 1);
-        token.data.symbol[sizeof(token.data.symbol) - 1] = '\0';
-
-    } else if (isConstantInt(str)) {
-        token.type = INT_CONST;
-        token.data.int_const = atoi(str);
-
-    } else if (isIdentifier(str)) {
-        token.type = INDENTIFIER;
-        strncpy(token.data.identifier, str, sizeof(token.data.identifier) - 1);
-        token.data.identifier[sizeof(token.data.identifier) - 1] = '\0';
-
-    } else if (isConstantStr(str)) {
-        token.type = STRING_CONST;
-
-        strncpy(token.data.str_const, &str[1], sizeof(token.data.identifier) - 1);
-        token.data.identifier[sizeof(token.data.identifier) - 1] = '\0';
-
-        for (i = 0; token.data.identifier[i] != '"'; i++);
-        if (token.data.identifier[i] == '"' ) token.data.identifier[i] = '\0';
+    } else if ((entry->code = findKeyword(text, len)) != MAX_KEYWORD) {
+        entry->type = KEYWORD;
 
     } else {
-        token.type = MAX_TOKEN_TYPE;
+        entry->code = 0;
+        entry->type = INT_CONST;
+        for (i = 0; i < len; i++) {
+            if (!IS_DIGIT(text[i])) {
+                entry->type = INDENTIFIER;
+                break;
+            }
+        }
     }
 
-    return token;
+    return;
 }
 
-static void printToken(struct token token, FILE *fp)
+static void printToken(struct token_entry *entry, char *text, FILE *fp)
 {
     char buf[256] = {0};
 
-    switch (token.type) {
+    switch (entry->type) {
         case KEYWORD:
-            fprintf(fp, "<keyword> %s </keyword>\n", keyword[token.data.keyword]);
+            fprintf(fp, "<keyword> %s </keyword>\n", keyword[entry->code]);
             break;
         case SYMBOL:
-            fprintf(fp, "<symbol> %s </symbol>\n", formatXML(token.data.symbol, buf));
+            fprintf(fp, "<symbol> %s </symbol>\n", formatXML(text, buf));
             break;
         case INT_CONST:
-            fprintf(fp, "<integerConstant> %d </integerConstant>\n", token.data.int_const);
+            fprintf(fp, "<integerConstant> %d </integerConstant>\n", atoi(text));
             break;
         case STRING_CONST:
-            fprintf(fp, "<stringConstant> %s </stringConstant>\n", token.data.str_const);
+            fprintf(fp, "<stringConstant> %s </stringConstant>\n", text);
             break;
         case INDENTIFIER:
-            fprintf(fp, "<identifier> %s </identifier>\n", token.data.identifier);
+            fprintf(fp, "<identifier> %s </identifier>\n", text);
             break;
         default:
             break;
     }
 }
 
-
 static char *formatXML(const char *in, char *out)
 {
     if (!strcmp(in, "<")) {
@@ -342,3 +303,238 @@ static char *formatXML(const char *in, char *out)
     return out;
 
 }
+
+// the character offset positions past the cursor, or EOF
+static int peek(JackTokenizer *pThis, size_t offset)
+{
+    if (pThis->pos + offset >= pThis->size) return EOF;
+
+    return (unsigned char)pThis->data[pThis->pos + offset];
+}
+
+// skips blanks and comments; the cursor is left on the next token
+static bool skipBlanks(JackTokenizer *pThis)
+{
+    size_t pos = pThis->pos;
+    int c;
+
+    while ((pos = skipSpaces(pThis->data, pos, pThis->size)) < pThis->size) {
+        c = pThis->data[pos];
+        if (c != '/' || pos + 1 >= pThis->size) {
+            break;
+        } else if (pThis->data[pos + 1] == '/') {
+            pos = findByte(pThis->data, pos + 2, pThis->size, '\n');
+        } else if (pThis->data[pos + 1] == '*') {
+            pos += 2;
+            while ((pos = findByte(pThis->data, pos, pThis->size, '*')) < pThis->size) {
+                if (pos + 1 < pThis->size && pThis->data[pos + 1] == '/') {
+                    pos += 2;
+                    break;
+                }
+                pos++;
+            }
+        } else {
+            break;
+        }
+    }
+
+    pThis->pos = pos < pThis->size ? pos : pThis->size;
+
+    return pThis->pos < pThis->size;
+}
+
+// the first byte at or past pos that is not blank, or size
+static size_t skipSpaces(const char *data, size_t pos, size_t size)
+{
+#if defined(__AVX2__)
+    const __m256i space = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t');
+    const __m256i lf = _mm256_set1_epi8('\n'), cr = _mm256_set1_epi8('\r');
+    __m256i v;
+    uint32_t mask;
+
+    for (; pos + 32 <= size; pos += 32) {
+        v = _mm256_loadu_si256((const __m256i *)(data + pos));
+        mask = _mm256_movemask_epi8(_mm256_or_si256(
+                   _mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, tab)),
+                   _mm256_or_si256(_mm256_cmpeq_epi8(v, lf), _mm256_cmpeq_epi8(v, cr))));
+        if (mask != 0xffffffffu)
+            return pos + __builtin_ctz(~mask);
+    }
+#elif defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t');
+    const __m128i lf = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+    __m128i v;
+    uint32_t mask;
+
+    for (; pos + 16 <= size; pos += 16) {
+        v = _mm_loadu_si128((const __m128i *)(data + pos));
+        mask = _mm_movemask_epi8(_mm_or_si128(
+                   _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+                   _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr))));
+        if (mask != 0xffff)
+            return pos + __builtin_ctz(~mask);
+    }
+#endif
+
+    while (pos < size && IS_BLANK((unsigned char)data[pos]))
+        pos++;
+
+    return pos;
+}
+
+// the first c at or past pos, or size
+static size_t findByte(const char *data, size_t pos, size_t size, char c)
+{
+#if defined(__AVX2__)
+    const __m256i key = _mm256_set1_epi8(c);
+    uint32_t mask;
+
+    for (; pos + 32 <= size; pos += 32) {
+        mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                   _mm256_loadu_si256((const __m256i *)(data + pos)), key));
+        if (mask != 0)
+            return pos + __builtin_ctz(mask);
+    }
+#elif defined(__SSE2__)
+    const __m128i key = _mm_set1_epi8(c);
+    uint32_t mask;
+
+    for (; pos + 16 <= size; pos += 16) {
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+                   _mm_loadu_si128((const __m128i *)(data + pos)), key));
+        if (mask != 0)
+            return pos + __builtin_ctz(mask);
+    }
+#endif
+
+    while (pos < size && data[pos] != c)
+        pos++;
+
+    return pos;
+}
+
+// a token is a word, a string constant with its quotes, or one symbol
+static void scanToken(JackTokenizer *pThis)
+{
+    int c = peek(pThis, 0);
+
+    if (c == '"') {
+        pThis->pos++;
+        while ((c = peek(pThis, 0)) != EOF && c != '"' && c != '\n')
+            pThis->pos++;
+        if (c == '"') pThis->pos++;
+    } else if (IS_WORD(c)) {
+        while ((c = peek(pThis, 0)) != EOF && IS_WORD(c))
+            pThis->pos++;
+    } else if (c != EOF) {
+        pThis->pos++;
+    }
+
+    return;
+}
+
+static void scanFile(JackTokenizer *pThis)
+{
+    struct token_entry *entry;
+    const char *text;
+    size_t begin, len;
+
+    pThis->tokens = (struct token_entry *)malloc(sizeof(struct token_entry) * ENTRY_BLOCK_SIZE);
+    pThis->num_tokens = 0;
+
+    while (skipBlanks(pThis)) {
+        begin = pThis->pos;
+        scanToken(pThis);
+
+        if (pThis->num_tokens != 0 && pThis->num_tokens % ENTRY_BLOCK_SIZE == 0) {
+            pThis->tokens = (struct token_entry *)realloc(pThis->tokens,
+                                sizeof(struct token_entry) * (pThis->num_tokens + ENTRY_BLOCK_SIZE));
+        }
+        entry = &pThis->tokens[pThis->num_tokens++];
+        entry->reserved = 0;
+        entry->offset = begin;
+        entry->length = pThis->pos - begin;
+
+        text = pThis->data + begin;
+        len  = entry->length;
+        if (text[0] == '"') {
+            // only a closed string is a constant; its name drops the quotes
+            entry->code = 0;
+            entry->type = (len >= 2 && text[len - 1] == '"') ? STRING_CONST : MAX_TOKEN_TYPE;
+            entry->name = entry->type == STRING_CONST ? internName(pThis, text + 1, len - 2)
+                                                      : internName(pThis, text, len);
+        } else {
+            classifyToken(text, len, entry);
+            entry->name = internName(pThis, text, len);
+        }
+    }
+
+    return;
+}
+
+// the name of text, added to names the first time it is seen
+static uint32_t internName(JackTokenizer *pThis, const char *text, size_t len)
+{
+    size_t mask = pThis->name_table_size - 1, i;
+    uint32_t name;
+
+    for (i = hashName(text, len) & mask; pThis->name_table[i] != 0; i = (i + 1) & mask) {
+        name = pThis->name_table[i] - 1;
+        if (!strncmp(pThis->names + name, text, len) && pThis->names[name + len] == '\0')
+            return name;
+    }
+
+    if (pThis->names_len + len + 1 > pThis->names_size) {
+        while (pThis->names_len + len + 1 > pThis->names_size)
+            pThis->names_size *= 2;
+        pThis->names = (char *)realloc(pThis->names, sizeof(char) * pThis->names_size);
+    }
+
+    name = pThis->names_len;
+    memcpy(pThis->names + name, text, len);
+    pThis->names[name + len] = '\0';
+    pThis->names_len += len + 1;
+
+    pThis->name_table[i] = name + 1;
+    if (++pThis->num_names * 2 > pThis->name_table_size)
+        growNameTable(pThis);
+
+    return name;
+}
+
+static void growNameTable(JackTokenizer *pThis)
+{
+    uint32_t *old = pThis->name_table;
+    size_t old_size = pThis->name_table_size, mask, i, j;
+    const char *text;
+
+    pThis->name_table_size *= 2;
+    pThis->name_table = (uint32_t *)calloc(pThis->name_table_size, sizeof(uint32_t));
+    mask = pThis->name_table_size - 1;
+
+    for (i = 0; i < old_size; i++) {
+        if (old[i] == 0) continue;
+        text = pThis->names + old[i] - 1;
+        for (j = hashName(text, strlen(text)) & mask; pThis->name_table[j] != 0; j = (j + 1) & mask)
+            ;
+        pThis->name_table[j] = old[i];
+    }
+
+    free(old);
+
+    return;
+}
+
+// 32 bit FNV-1a
+static uint32_t hashName(const char *text, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
@@ -1,35 +1,48 @@
 /*
- *  jack_tokenizer.h 
+ *  jack_tokenizer.h
  */
 
 #ifndef _JACK_TOKENIZER_H_
 #define _JACK_TOKENIZER_H_
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include "common.h"
 
-union token_data {
-    enum KeyWord keyword;
-    char         symbol[2];
-    unsigned int int_const;
-    char         str_const[256];
-    char         identifier[256];
-};
-
-struct token {
-    enum TokenType type;
-    union token_data data;
+// a token of the source, found once when the file is opened
+struct token_entry {
+    uint8_t  type;          // enum TokenType
+    uint8_t  code;          // enum KeyWord, or the symbol character
+    uint16_t reserved;
+    uint32_t offset;        // of its text in data
+    uint32_t length;
+    uint32_t name;          // interned text; a string constant without its quotes
 };
 
 typedef struct jack_tokenizer {
-    FILE *fp;
-    char *current_token;
-    struct token token;
+    char *data;             // mapped source file
+    size_t size;
+    size_t pos;             // next character to scan
+    struct token_entry *tokens;
+    size_t num_tokens;
+    size_t next;            // next token advance returns
+    struct token_entry *current;
+    char *current_token;    // text of the current token, in names
+
+    // every distinct token text once, NUL terminated; a name is its offset
+    char *names;
+    size_t names_len;
+    size_t names_size;
+    uint32_t *name_table;   // open addressing, name + 1 or 0 for free
+    size_t name_table_size;
+    size_t num_names;
 
     void (*init)(struct jack_tokenizer *, char *);
     bool (*hasMoreTokens)(struct jack_tokenizer *);
     void (*advance)(struct jack_tokenizer *);
+    void (*reset)(struct jack_tokenizer *);
     enum TokenType (*tokenType)(struct jack_tokenizer *);
     enum KeyWord (*keyWord)(struct jack_tokenizer *);
     char *(*symbol)(struct jack_tokenizer *);
@@ -43,6 +56,7 @@ typedef struct jack_tokenizer {
 extern void _jack_tokenizer_init(JackTokenizer *pThis, char *name);
 extern bool _jack_tokenizer_hasMoreTokens(JackTokenizer *pThis);
 extern void _jack_tokenizer_advance(JackTokenizer *pThis);
+extern void _jack_tokenizer_reset(JackTokenizer *pThis);
 extern enum TokenType _jack_tokenizer_tokenType(JackTokenizer *pThis);
 extern enum KeyWord _jack_tokenizer_keyWord(JackTokenizer *pThis);
 extern char *_jack_tokenizer_symbol(JackTokenizer *pThis);
@@ -53,9 +67,24 @@ extern void _jack_tokenizer_del(JackTokenizer *pThis);
 extern void _jack_tokenizer_print_cur_token(JackTokenizer *pThis, FILE *fp);
 
 #define newJackTokenizer() {       \
+    .data              = NULL,                              \
+    .size              = 0,                                 \
+    .pos               = 0,                                 \
+    .tokens            = NULL,                              \
+    .num_tokens        = 0,                                 \
+    .next              = 0,                                 \
+    .current           = NULL,                              \
+    .current_token     = NULL,                              \
+    .names             = NULL,                              \
+    .names_len         = 0,                                 \
+    .names_size        = 0,                                 \
+    .name_table        = NULL,                              \
+    .name_table_size   = 0,                                 \
+    .num_names         = 0,                                 \
     .init              = _jack_tokenizer_init,              \
     .hasMoreTokens     = _jack_tokenizer_hasMoreTokens,     \
     .advance           = _jack_tokenizer_advance,           \
+    .reset             = _jack_tokenizer_reset,             \
     .tokenType         = _jack_tokenizer_tokenType,         \
     .keyWord           = _jack_tokenizer_keyWord,           \
     .symbol            = _jack_tokenizer_symbol,            \
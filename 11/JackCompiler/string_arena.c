@@ -0,0 +1,82 @@
+/*
+ * string_arena.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+
+#include "string_arena.h"
+
+#define ARENA_BLOCK_SIZE 4096
+
+static char *allocate(StringArena *pThis, size_t len);
+
+void _string_arena_init(StringArena *pThis)
+{
+    pThis->blocks = NULL;
+    pThis->used = 0;
+
+    return;
+}
+
+// the printf style text, saved in the arena
+char *_string_arena_format(StringArena *pThis, const char *format, ...)
+{
+    va_list ap;
+    char *str;
+    int len;
+
+    va_start(ap, format);
+    len = vsnprintf(NULL, 0, format, ap);
+    va_end(ap);
+
+    str = allocate(pThis, len + 1);
+
+    va_start(ap, format);
+    vsnprintf(str, len + 1, format, ap);
+    va_end(ap);
+
+    return str;
+}
+
+void _string_arena_del(StringArena *pThis)
+{
+    struct arena_block *block, *next;
+
+    for (block = pThis->blocks; block != NULL; block = next) {
+        next = block->next;
+        free(block);
+    }
+    pThis->blocks = NULL;
+    pThis->used = 0;
+
+    return;
+}
+
+// len bytes from the newest block; a string longer than a block gets one
+// of its own
+static char *allocate(StringArena *pThis, size_t len)
+{
+    struct arena_block *block = pThis->blocks;
+    size_t size;
+
+    if (block == NULL || block->size - pThis->used < len) {
+        size = len > ARENA_BLOCK_SIZE ? len : ARENA_BLOCK_SIZE;
+        block = (struct arena_block *)malloc(sizeof(struct arena_block) + size);
+        if (block == NULL) {
+            fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
+            exit errno;
+        }
+        block->next = pThis->blocks;
+        block->size = size;
+        pThis->blocks = block;
+        pThis->used = 0;
+    }
+
+    pThis->used += len;
+
+    return block->data + pThis->used - len;
+}
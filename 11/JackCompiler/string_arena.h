@@ -0,0 +1,39 @@
+/*
+ * string_arena.h
+ */
+
+#ifndef _STRING_ARENA_H_
+#define _STRING_ARENA_H_
+
+#include <stddef.h>
+
+struct arena_block {
+    struct arena_block *next;
+    size_t size;
+    char data[];
+};
+
+// strings of one compilation unit, of any length; blocks are never moved,
+// so a string stays valid until del frees them all at once
+typedef struct string_arena {
+    struct arena_block *blocks;     // newest first
+    size_t used;                    // of the newest block
+
+    void (*init)(struct string_arena *);
+    char *(*format)(struct string_arena *, const char *, ...);
+    void (*del)(struct string_arena *);
+} StringArena;
+
+extern void _string_arena_init(StringArena *pThis);
+extern char *_string_arena_format(StringArena *pThis, const char *format, ...);
+extern void _string_arena_del(StringArena *pThis);
+
+#define newStringArena() {              \
+    .blocks = NULL,                     \
+    .used   = 0,                        \
+    .init   = _string_arena_init,       \
+    .format = _string_arena_format,     \
+    .del    = _string_arena_del,        \
+}
+
+#endif
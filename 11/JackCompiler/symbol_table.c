@@ -45,10 +45,8 @@ void _symbol_table_define(struct symbol_table *pThis, char *name, char *type, en
             break;
     }
 
-    strncpy(row->name, name, sizeof(row->name) - 1);
-    row->name[sizeof(row->name) - 1] = '\0';
-    strncpy(row->type, type, sizeof(row->type) - 1);
-    row->type[sizeof(row->type) - 1] = '\0';
+    row->name = name;
+    row->type = type;
     row->kind = kind;
     row->index = pThis->index[kind];
 
@@ -108,18 +106,20 @@ void _symbol_table_del(struct symbol_table *pThis)
 
 static struct sym_table *search_identification(struct symbol_table *pThis, char *name)
 {
-    size_t i;
+    int i, n;
     struct sym_table *table;
 
     table = pThis->sub;
+    n = pThis->index[ID_ARG] + pThis->index[ID_VAR];
 
-    for (i = 0; i < sizeof(table) || strlen(table[i].name) != 0; i++)
+    for (i = 0; i < n; i++)
         if (!strcmp(table[i].name, name))
             return &(table[i]);
 
     table = pThis->class;
+    n = pThis->index[ID_STATIC] + pThis->index[ID_FIELD];
 
-    for (i = 0; i < sizeof(table) || strlen(table[i].name) != 0; i++)
+    for (i = 0; i < n; i++)
         if (!strcmp(table[i].name, name))
             return &(table[i]);
 
@@ -18,9 +18,10 @@ enum kind {
     ID_MAX,
 };
 
+// name and type are not copied; they must live as long as the table
 struct sym_table {
-    char name[1024];
-    char type[1024];
+    char *name;
+    char *type;
     enum kind kind;
     int  index;
 };
@@ -10,10 +10,16 @@
 
 
 
+// without an output file the commands are kept in buf, which the caller
+// frees once the writer is closed
 void _vm_writer_init(struct vm_writer *pThis, char *ostream)
 {
-    pThis->fp = fopen(ostream, "w");
-    setbuf(pThis->fp, NULL);
+    if (ostream == NULL) {
+        pThis->fp = open_memstream(&pThis->buf, &pThis->len);
+    } else {
+        pThis->fp = fopen(ostream, "w");
+        setbuf(pThis->fp, NULL);
+    }
     if (pThis->fp == NULL) {
         fprintf(stderr, "%s %s() : %s\n", __FILE__, __FUNCTION__, strerror(errno));
         exit errno;
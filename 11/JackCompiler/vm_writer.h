@@ -35,6 +35,8 @@ enum command {
 
 typedef struct vm_writer {
     FILE *fp;
+    char *buf;          // commands written to memory, complete after close
+    size_t len;
 
     void (*init)(struct vm_writer *, char *);
     void (*writePush)(struct vm_writer *, enum segment, unsigned int);
@@ -62,6 +64,9 @@ extern void _vm_writer_writeReturn(struct vm_writer *pThis);
 extern void _vm_writer_close(struct vm_writer *pThis);
 
 #define newVMWriter() {                            \
+    .fp              = NULL,                       \
+    .buf             = NULL,                       \
+    .len             = 0,                          \
     .init            = _vm_writer_init,            \
     .writePush       = _vm_writer_writePush,       \
     .writePop        = _vm_writer_writePop,        \